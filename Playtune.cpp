@@ -59,7 +59,7 @@
 
   ****  The public Playtune interface  ****
 
-  There are five public functions and one public variable.
+  There are thirteen public functions, one public variable, and one public structure.
 
   void tune_initchan(byte pin)
 
@@ -72,7 +72,10 @@
 
     Call this pointing to a "score bytestream" to start playing a tune.  It will
     only play as many simultaneous notes as you have initialized tone generators;
-    any more will be ignored.  See below for the format of the score bytestream.
+    any more will be ignored, unless TUNE_ARPEGGIO is set (see "Arpeggios" below).
+    See below for the format of the score bytestream.
+    A score that tune_verify() finds bad is not played, and whatever was playing
+    goes on.
 
   boolean tune_playing
 
@@ -81,18 +84,118 @@
 
   void tune_stopscore()
 
-    This will stop a currently playing score without waiting for it to end by itself.
+    This will stop a currently playing score without waiting for it to end by itself,
+    and forget any scores that were queued to play after it.
+
+  boolean tune_queue(byte *score)
+  boolean tune_queue(tune_catalog_t *entry)
+
+    Call this to play a score as soon as the current one ends, with no gap
+    between them and without having to watch for the end yourself.  If no score
+    is playing, it starts right away.  Up to TUNE_QUEUE_SIZE (4) scores can be
+    waiting; tune_queue returns false if the queue is full, or if the score is
+    bad.  When a score ends, any notes still sounding are stopped before the
+    next one starts.  The tune_playing variable stays "true" until the last
+    score in the queue ends.
+
+    The second form takes a pointer to an entry in a PROGMEM catalog of scores:
+
+      struct tune_catalog_t {
+        const byte *score;        // the score bytestream
+        byte hdr_length;          // the length of its file header, or 0
+        byte f1;                  // flag byte 1 of the header (0x80: volume present)
+        unsigned long duration;   // how long it plays, in milliseconds
+      };
+
+    The header information is used instead of reading the score's header, and
+    the durations can be used to show how long a playlist will take.  Generate
+    the catalog with the playtune_analyze program in the extras/host directory.
+
+  byte tune_queued()
+
+    This returns the number of scores waiting in the queue.  A jukebox can keep
+    the queue full with something like:
+      while (pt.tune_queued() < TUNE_QUEUE_SIZE && pt.tune_queue(&catalog[next])) ++next;
+
+  boolean tune_verify(byte *score)
+
+    This checks a score in one pass, and returns false if it is bad: if its
+    volume bytes don't agree with the header (or ASSUME_VOLUME), or if it
+    doesn't end with a stop or restart command within 64K bytes, or if it
+    restarts without ever waiting.  Commands Playtune doesn't know are ignored,
+    as they are when the score plays.  tune_playscore() and tune_queue() do this
+    themselves the first time they see a score, and refuse bad ones; calling it
+    earlier, as in setup(), just keeps the check from delaying the start.  What
+    was found for the last four scores is remembered, so checking again takes no
+    time.  A good score whose voices all have tone generators and whose notes
+    are all 127 or below is then played without checking each command in the
+    interrupt routine; others are played with the checks, as before.  Checking
+    takes less than a millisecond for each thousand bytes of score at 16 Mhz.
 
   void tune_delay(unsigned int msec)
 
     Delay for "msec" milliseconds.  This is provided because the usual Arduino
     "delay" function will stop working if you use all of your processor's
-    timers for generating tones.
+    timers for generating tones.  The processor sleeps between interrupts
+    while it waits.
+
+  void tune_idle()
+
+    If a score is playing, or this is a follower (see below), put the processor
+    into idle sleep until the next interrupt.  Call this in a loop while waiting
+    for a score to finish instead of spinning, to save power:
+      while (pt.tune_playing) pt.tune_idle();
+    The timers keep running during idle sleep, so the music isn't affected.
+
+  unsigned long tune_sleepcycles(boolean reset)
+
+    Return the approximate number of processor cycles spent sleeping in
+    tune_delay() and tune_idle(), and if "reset" is true, start counting
+    again from zero.  Compare it with the elapsed time to see how busy the
+    processor was.  At 16 Mhz the count overflows after about 268 seconds.
 
   void tune_stopchans()
 
-    This disconnects all the timers from their pins and stops the interrupts.
-    Do this when you don't want to play any more tunes.
+    This stops the score and forgets the queued ones, as tune_stopscore() does,
+    disconnects all the timers from their pins, and stops the interrupts.  A
+    leader or follower goes back to playing alone.  Do this when you don't want
+    to play any more tunes.
+
+  void tune_lead(Stream *link, unsigned long baud)
+  void tune_follow(Stream *link, unsigned long baud, byte first_voice)
+  void tune_link_poll()
+
+    These let several boards play one score with more voices than any of them
+    has timers.  They are only built when TUNE_LINK is set to 1 in Playtune.h,
+    because the link takes about 180 bytes of RAM.  Connect the serial transmit
+    pin of the "leader" to the receive pins of the "followers", and call these
+    after tune_initchan().  The leader calls tune_lead() with the serial port
+    (Serial1, say, already started with begin(baud)) and its speed, and then
+    plays scores as usual.  It plays the voices it has timers for itself and
+    sends the others over the link.  Each follower calls tune_follow() with its
+    port, the speed, and the number of the first voice it should play; it plays
+    that one and the following ones on its own timers, in order.  For example, a
+    Mega2560 leader plays voices 0 to 5, and a Mega2560 follower with
+    first_voice 6 plays voices 6 to 11.  A follower must call tune_link_poll()
+    often to take in what arrives, so its loop should be something like:
+      while (1) { pt.tune_link_poll(); pt.tune_idle(); }
+    The serial port can be anything that is an Arduino Stream.
+
+    The leader sends each moment of the score 20 msec before it is due, so the
+    followers can play it at the right time, and it starts each score that much
+    later itself.  It also sends the time on its clock every 100 msec, and the
+    followers use that to keep their clocks in step with it.  A follower needs
+    two of those to measure how fast its clock is, so for about the first 100
+    msec of the first score after tune_follow() its notes can be off by a few
+    hundred usec if its crystal is 0.3% off the leader's; after that they are
+    within a few usec.  Queue the next score at least 20 msec before the
+    current one ends, or the followers will start it a little late.  Call
+    tune_lead() or tune_follow() with a null link to go back to playing alone.
+    Followers don't play scores of their own.
+
+  When no score is playing and no tune_delay() is in progress, the timer 1
+  alarm used to time them is turned off, so that Playtune doesn't wake the
+  processor at all.  A follower keeps it on, to keep time with the leader.
 
 
    *****  The score bytestream  *****
@@ -168,17 +271,86 @@
 
    Timer 0 is assigned last (except on the ATmega32u), because using
    it will disable the Arduino millis(), delay(), and the PWM functions.
-   Timer 1 is used first and is used to time the score, so it is always
-   kept running even if it isn't playing a note.
+   Timer 1 is used first and is also used to time the score and tune_delay().
+   It counts freely at 1/8 of the processor clock, and the end of each wait is
+   an alarm set on its second compare unit, so a wait takes one interrupt, plus
+   one for every 30 milliseconds or so of a long wait, whether or not timer 1
+   is playing a note. Its note is played by moving the first compare unit half
+   a period ahead at every toggle, instead of restarting the counter.
 
    The lowest MIDI note that can be played using the 8-bit timers
    depends on your processor's clock frequency.
       8 Mhz clock: note 12 (about 16.5 Hz, which is below the piano keyboard)
      16 Mhz clock: note 24 (about 32.5 Hz, C in octave 1)
+   Timer 1 can play all the notes with an 8 Mhz clock, and from note 11
+   (about 15.4 Hz) up with a 16 Mhz clock.
 
    The highest MIDI note (127, about 12,544 Hz) can always be played, but can't
    always be heard.
 
+   ****  Making it smaller  ****
+
+   The settings at the top of Playtune.h choose what is built, so a sketch that
+   doesn't use a feature doesn't pay for it in flash or RAM.  Edit Playtune.h
+   itself to change them: the library is compiled apart from the sketch, so
+   defining them in the sketch before #include <Playtune.h> has no effect on it,
+   and makes the sketch's idea of the Playtune class differ from the library's.
+   The settings are:
+     TUNE_CHANS       the most tone generators; the code and variables for the
+                      timers after that, and their interrupt routines, are left out
+     TUNE_DELAY       0 leaves out tune_delay() and its deadline
+     TUNE_HEADER      0 leaves out reading the file header; then whether scores
+                      have volume bytes is fixed by ASSUME_VOLUME in Playtune.cpp
+     TUNE_QUEUE_SIZE  how many scores tune_queue() can hold
+     TUNE_LINK        1 builds tune_lead() and tune_follow(); it is 0 unless
+                      needed, because the link takes about 180 bytes of RAM
+     TUNE_VERIFY      0 leaves out tune_verify(); then scores are never refused,
+                      and every command is checked as it is played
+   The output pins can also be fixed there by port and bit, which makes the
+   interrupt routines toggle them with constant instructions instead of
+   through pointers kept in RAM.  The script size_report.sh in extras/size_report
+   compiles a small sketch with each of these turned off in turn and shows the
+   flash and RAM it takes; it needs arduino-cli, and its flash numbers haven't
+   been measured for this release.  Its companion ram_report.sh needs only g++,
+   and counts the RAM of Playtune's own variables.  On an ATmega328P they take:
+      with TUNE_LINK 1           253 bytes
+      the defaults                74
+        and TUNE_DELAY 0          69
+        and TUNE_HEADER 0         64
+        and TUNE_QUEUE_SIZE 1     55
+        and TUNE_VERIFY 0         36
+        and fixed pins            27
+        and TUNE_CHANS 1          25
+   Before these settings and the score queue were added, they took 39 bytes.
+
+   ****  Arpeggios  ****
+
+   A score with more voices than there are tone generators loses the notes of
+   the extra voices.  With TUNE_ARPEGGIO set in Playtune.h to a rate in Hz, such
+   as 50, those notes take turns on timer 1 with the note of its own voice
+   instead, the way chiptunes play chords, so a dense passage on a Nano keeps
+   its harmony as a quick arpeggio.  The newest note gets the first turn.  The
+   turns are timed by the same alarm as the score's waits, and each one is a
+   single store of a half period that was worked out when the note started, so
+   it costs one short interrupt when no wait ends at the same time.  With -i, the
+   playtune_trace host program shows how many turns a score took and what they
+   cost.  The voices of a leader's followers (see tune_lead) don't take turns.
+
+   ****  Tesla coils  ****
+
+   With TESLA_COIL set to 1 near the top of Playtune.cpp, the output is meant
+   for the interrupter of a Tesla coil instead of a speaker.  Each rising edge of
+   any tone generator starts a pulse of TESLA_PULSE_USEC on pin TESLA_PIN, and
+   the coil sounds the notes.  The 8-bit timer (T2, or T0 on the ATmega32u)
+   times the pulses, so only the other timers play notes: 4 on the Mega2560,
+   3 on the ATmega32u, and 1 on the others.  To keep the coil from overheating,
+   edges that come soon after a pulse started are merged into it, each tone
+   generator pulses no faster than TESLA_VOICE_USEC allows (its notes are moved
+   down by octaves until they fit), and all together the coil is on no more than
+   TESLA_DUTY_PERCENT of the time, with short bursts allowed.  Edges that would
+   break a limit are dropped.  Checking the limits takes a few comparisons per
+   edge.  The playtune_tesla host program checks the pulses Playtune makes.
+
    ****  Nostalgia from me  ****
 
    Writing Playtune was a lot of fun, because it essentially duplicates what I did
@@ -248,17 +420,63 @@
       - Various reformatting to make it easier to read.
       - Allow use of the fourth timer on the ATmega32U4 (Micro, Leonardo)
       - Change to the more permissive MIT license.
+   18 October 2026
+      - Sleep between interrupts in tune_delay() instead of polling, and add
+        tune_idle() to do the same while a score plays.
+      - Turn off the timer 1 interrupt when nothing needs it.
+      - Add tune_sleepcycles() to report how long the processor slept.
+      - Add tune_queue() and tune_queued() to play a list of scores without
+        gaps, and the tune_catalog_t PROGMEM catalog of scores.
+      - Time score waits and tune_delay() with an alarm on timer 1's compare B
+        unit instead of counting the toggles of its note, so a wait takes one
+        interrupt and the timer 1 toggle routine does nothing else. The waits
+        are now exact instead of being rounded to a toggle of the note.
+      - Add tune_lead(), tune_follow(), and tune_link_poll(), so that boards
+        connected by a serial link can play the voices of one score together.
+      - Implement the Tesla coil version: a fixed pulse for each rising edge,
+        with merging of nearby edges, and per-voice and duty limits.
+      - Add the TUNE_CHANS, TUNE_DELAY, and TUNE_HEADER settings and fixed pins,
+        so that what a sketch doesn't use is left out of the build. The file
+        header is no longer kept in RAM.
+      - Check each score once before it plays, refuse the bad ones, and play the
+        good ones without checking their commands again; add tune_verify().
+      - Add TUNE_ARPEGGIO: notes of voices that have no tone generator take turns
+        on timer 1 instead of being lost.
 
   -----------------------------------------------------------------------------------------*/
 
 #include <Arduino.h>
+#include <avr/sleep.h>
 #include "Playtune.h"
 
 #ifndef DBUG
 #define DBUG 0          // debugging?
 #endif
+#ifndef ASSUME_VOLUME
 #define ASSUME_VOLUME 0 // assume volume information is present in bytestream files without headers?
+#endif
+#ifndef TESLA_COIL
 #define TESLA_COIL 0    // special Tesla Coil version?
+#endif
+
+#if TESLA_COIL
+/* The Tesla coil's interrupter is driven from one pin, which gets a pulse of fixed length
+  at each rising edge of any tone generator's square wave. Timer 2 (timer 0 on the
+  ATmega32U4) times the pulses, so it doesn't play notes. To protect the coil,
+   - edges that come within TESLA_MERGE_USEC of the start of a pulse join that pulse
+     instead of firing one that would overlap it or follow right on its heels
+   - each tone generator fires no more than one pulse every TESLA_VOICE_USEC, and its
+     notes are moved down by octaves until they are that slow
+   - all together, the pulses keep the coil on for no more than TESLA_DUTY_PERCENT of
+     the time, with bursts of up to TESLA_BURST pulses closer together than that
+  Edges that would break a limit are dropped. */
+#define TESLA_PIN 13            // drives the interrupter
+#define TESLA_PULSE_USEC 50     // the on-time of each pulse, at most 127 usec at 16 Mhz
+#define TESLA_MERGE_USEC 150    // edges this soon after a pulse started are merged into it
+#define TESLA_VOICE_USEC 1000   // the shortest time between the pulses of one tone generator
+#define TESLA_DUTY_PERCENT 10   // the most time the coil may be on, on average
+#define TESLA_BURST 8           // how many pulses may come faster than that
+#endif
 
 
 struct file_hdr_t {  // the optional bytestream file header
@@ -268,12 +486,20 @@ struct file_hdr_t {  // the optional bytestream file header
   unsigned char f1;         // flag byte 1
   unsigned char f2;         // flag byte 2
   unsigned char num_tgens;  // how many tone generators are used by this score
-} file_header;
+};
 #define HDR_F1_VOLUME_PRESENT 0x80
 #define HDR_F1_INSTRUMENTS_PRESENT 0x40
 #define HDR_F1_PERCUSSION_PRESENT 0x20
 
-// timer ports and masks
+// The score commands
+#define CMD_PLAYNOTE	0x90	/* play a note: low nibble is generator #, note is next byte */
+#define CMD_STOPNOTE	0x80	/* stop a note: low nibble is generator # */
+#define CMD_INSTRUMENT  0xc0 /* change instrument; low nibble is generator #, instrument is next byte */
+#define CMD_RESTART	0xe0	/* restart the score from the beginning */
+#define CMD_STOP	0xf0	/* stop playing */
+/* if CMD < 0x80, then the other 7 bits and the next byte are a 15-bit big-endian number of msec to wait */
+
+// The ATmega8's timer registers go by other names
 
 #if defined(__AVR_ATmega8__)
 #define TCCR2A TCCR2
@@ -285,32 +511,29 @@ struct file_hdr_t {  // the optional bytestream file header
 #define OCIE2A OCIE2
 #define TIMER2_COMPA_vect TIMER2_COMP_vect
 #define TIMSK1 TIMSK
-#endif
-
-#if !defined(__AVR_ATmega8__)
-volatile byte *timer0_pin_port;
-volatile byte timer0_pin_mask;
-#endif
-volatile byte *timer1_pin_port;
-volatile byte timer1_pin_mask;
-#if !defined(__AVR_ATmega32U4__)
-volatile byte *timer2_pin_port;
-volatile byte timer2_pin_mask;
-#endif
-#if defined(__AVR_ATmega1280__)||defined(__AVR_ATmega2560__)||defined(__AVR_ATmega32U4__)
-volatile byte *timer3_pin_port;
-volatile byte timer3_pin_mask;
-volatile byte *timer4_pin_port;
-volatile byte timer4_pin_mask;
-#endif
-#if defined(__AVR_ATmega1280__)||defined(__AVR_ATmega2560__)
-volatile byte *timer5_pin_port;
-volatile byte timer5_pin_mask;
+#define TIFR1 TIFR
 #endif
 
 // Define the order to allocate timers.
 
+#if TESLA_COIL  // the 8-bit timers time the pulses, and only the others play notes
 #if defined(__AVR_ATmega1280__)||defined(__AVR_ATmega2560__)
+#define AVAILABLE_TIMERS 4
+const byte PROGMEM tune_pin_to_timer_PGM[] = {
+  1, 3, 4, 5
+};
+#elif defined(__AVR_ATmega32U4__)
+#define AVAILABLE_TIMERS 3
+const byte PROGMEM tune_pin_to_timer_PGM[] = {
+  1, 3, 4
+};
+#else
+#define AVAILABLE_TIMERS 1
+const byte PROGMEM tune_pin_to_timer_PGM[] = {
+  1
+};
+#endif
+#elif defined(__AVR_ATmega1280__)||defined(__AVR_ATmega2560__)
 #define AVAILABLE_TIMERS 6
 const byte PROGMEM tune_pin_to_timer_PGM[] = {
   1, 2, 3, 4, 5, 0
@@ -332,27 +555,286 @@ const byte PROGMEM tune_pin_to_timer_PGM[] = {
 };
 #endif
 
+#if TUNE_CHANS < 1
+#error "TUNE_CHANS must be at least 1: timer 1 times the score"
+#elif TUNE_CHANS < AVAILABLE_TIMERS
+#undef AVAILABLE_TIMERS
+#define AVAILABLE_TIMERS TUNE_CHANS
+#endif
+
+// Which tone generator each timer is, in that order. The timers that aren't among the
+// first AVAILABLE_TIMERS, or that the processor doesn't have, are left out of the code.
+
+#if TESLA_COIL
+#define TIMER1_CHAN 0
+#if defined(__AVR_ATmega1280__)||defined(__AVR_ATmega2560__)||defined(__AVR_ATmega32U4__)
+#define TIMER3_CHAN 1
+#define TIMER4_CHAN 2
+#endif
+#if defined(__AVR_ATmega1280__)||defined(__AVR_ATmega2560__)
+#define TIMER5_CHAN 3
+#endif
+#elif defined(__AVR_ATmega1280__)||defined(__AVR_ATmega2560__)
+#define TIMER1_CHAN 0
+#define TIMER2_CHAN 1
+#define TIMER3_CHAN 2
+#define TIMER4_CHAN 3
+#define TIMER5_CHAN 4
+#define TIMER0_CHAN 5
+#elif defined(__AVR_ATmega8__)
+#define TIMER1_CHAN 0
+#define TIMER2_CHAN 1
+#elif defined(__AVR_ATmega32U4__)
+#define TIMER1_CHAN 0
+#define TIMER0_CHAN 1
+#define TIMER3_CHAN 2
+#define TIMER4_CHAN 3
+#else
+#define TIMER1_CHAN 0
+#define TIMER2_CHAN 1
+#define TIMER0_CHAN 2
+#endif
+#ifndef TIMER0_CHAN
+#define TIMER0_CHAN 9
+#endif
+#ifndef TIMER2_CHAN
+#define TIMER2_CHAN 9
+#endif
+#ifndef TIMER3_CHAN
+#define TIMER3_CHAN 9
+#endif
+#ifndef TIMER4_CHAN
+#define TIMER4_CHAN 9
+#endif
+#ifndef TIMER5_CHAN
+#define TIMER5_CHAN 9
+#endif
+#define TIMER_USED(n) (TIMER##n##_CHAN < AVAILABLE_TIMERS)
+#if TIMER_USED(3) || TIMER_USED(5) || (TIMER_USED(4) && !defined(__AVR_ATmega32U4__))
+#define OTHER_16BIT_TIMERS 1  // 16-bit timers besides timer 1
+#else
+#define OTHER_16BIT_TIMERS 0
+#endif
+
+// timer ports and masks
+
+#ifdef TUNE_PORT0  // fixed pins: constant port instructions
+#define TUNE_FIXED_PINS 1
+#if AVAILABLE_TIMERS > 1 && !defined(TUNE_PORT1) || AVAILABLE_TIMERS > 2 && !defined(TUNE_PORT2) \
+ || AVAILABLE_TIMERS > 3 && !defined(TUNE_PORT3) || AVAILABLE_TIMERS > 4 && !defined(TUNE_PORT4) \
+ || AVAILABLE_TIMERS > 5 && !defined(TUNE_PORT5)
+#error "fix the pins of all the tone generators, or lower TUNE_CHANS"
+#endif
+#define TUNE_CAT(a, b) a##b
+#define TUNE_XCAT(a, b) TUNE_CAT(a, b)
+#define TIMER_PORT(n) TUNE_XCAT(PORT, TUNE_XCAT(TUNE_PORT, TIMER##n##_CHAN))
+#define TIMER_MASK(n) (1 << TUNE_XCAT(TUNE_BIT, TIMER##n##_CHAN))
+#define TIMER_SET_PIN(n, pin)
+#else
+#define TUNE_FIXED_PINS 0
+#define TIMER_PORT(n) (*timer##n##_pin_port)
+#define TIMER_MASK(n) timer##n##_pin_mask
+#define TIMER_SET_PIN(n, pin) { \
+    timer##n##_pin_port = portOutputRegister(digitalPinToPort(pin)); \
+    timer##n##_pin_mask = digitalPinToBitMask(pin); }
+#endif
+
+#if !TUNE_FIXED_PINS
+volatile byte *timer1_pin_port;
+volatile byte timer1_pin_mask;
+#if TIMER_USED(0)
+volatile byte *timer0_pin_port;
+volatile byte timer0_pin_mask;
+#endif
+#if TIMER_USED(2)
+volatile byte *timer2_pin_port;
+volatile byte timer2_pin_mask;
+#endif
+#if TIMER_USED(3)
+volatile byte *timer3_pin_port;
+volatile byte timer3_pin_mask;
+#endif
+#if TIMER_USED(4)
+volatile byte *timer4_pin_port;
+volatile byte timer4_pin_mask;
+#endif
+#if TIMER_USED(5)
+volatile byte *timer5_pin_port;
+volatile byte timer5_pin_mask;
+#endif
+#endif
+
 //  Other local varables
 
 byte _tune_pins[AVAILABLE_TIMERS];
 byte _tune_num_chans = 0;
 
-/* one of the timers is also used to time
-  - score waits (whether or not that timer is playing a note)
+/* Timer 1 counts freely at F_CPU/8, and besides playing a note it is used to time
+  - score waits
   - tune_delay() delay requests
-  We currently use timer1, since that is the common one available on different microcontrollers.
+  We use timer1 since that is the common one available on different microcontrollers.
+  Its compare A unit plays the note: the interrupt moves OCR1A half a period ahead.
+  Its compare B unit is an alarm set for whichever wait or delay ends first, so a wait
+  costs one interrupt instead of one for every toggle of a note. Waits are kept as
+  absolute deadlines on a 32-bit extension of the counter, so they don't drift.
 */
-volatile unsigned wait_timer_frequency2;       /* its current frequency */
-volatile unsigned wait_timer_old_frequency2;   /* its previous frequency */
-volatile boolean wait_timer_playing = false;   /* is it currently playing a note? */
-volatile boolean doing_delay = false;          /* are we using it for a tune_delay()? */
-volatile unsigned long wait_toggle_count;      /* countdown score waits */
-volatile unsigned long delay_toggle_count;     /* countdown tune_ delay() delays */
+#define WAIT_MARGIN 32      /* timer 1 ticks: deadlines closer than this have arrived */
+#define WAIT_MAX_ALARM 0xf000  /* the longest alarm, leaving time for the interrupt to be late */
+volatile uint16_t timer1_half_period;         /* timer 1 ticks per half period of its note */
+unsigned long wait_base;                      /* timer 1 time when the alarm was last set */
+unsigned long score_deadline;                 /* when the current score wait ends */
+#if TUNE_DELAY
+unsigned long delay_deadline;                 /* when the tune_delay() in progress ends */
+volatile boolean doing_delay = false;         /* are we using it for a tune_delay()? */
+#else
+#define doing_delay false                     /* there are no delays */
+#endif
+unsigned long sleep_cycles = 0;                /* processor cycles spent sleeping */
+
+#if TUNE_ARPEGGIO
+/* The notes of voices that have no tone generator aren't lost: they take turns with the
+  note of timer 1's voice on timer 1, TUNE_ARPEGGIO turns a second, the way chiptunes play
+  chords. The turns are timed by the alarm, on the score's timeline. A turn only changes
+  timer1_half_period, which the compare A routine uses from its next toggle on, because
+  each note's half period is worked out once, when it starts. */
+#define ARP_TICKS (F_CPU / 8 / TUNE_ARPEGGIO)  /* timer 1 ticks per turn */
+#define ARP_VOICES 16
+#define ARP_SHARING (arp_voices & (arp_voices - 1))  /* do several voices take turns? */
+uint16_t arp_voices = 0;                      /* the voices on timer 1, a bit for each */
+uint16_t arp_half_period[ARP_VOICES];         /* timer 1 ticks per half period of each one's note */
+byte arp_current;                             /* the voice whose turn it is */
+unsigned long arp_deadline;                   /* when the next turn starts */
+#endif
+
+#if TESLA_COIL
+/* The limits are kept as times on the timer 1 timeline, so an edge costs the same few
+  comparisons whatever happened before it. The duty limit is the generic cell rate
+  algorithm: tesla_duty_next moves TESLA_SPACING ahead with every pulse, and a pulse may
+  fire while it is no more than TESLA_BURST - 1 spacings ahead of now. The comparisons
+  are of how far ahead a time is, so times long past, that have wrapped around, are
+  still seen as past. Edges only come while a score plays, which keeps the alarm
+  running and the timeline right. */
+#define TESLA_TICKS(usec) ((unsigned long)(usec) * (F_CPU / 1000000UL) / 8)  /* timer 1 ticks */
+#define TESLA_SPACING TESLA_TICKS(TESLA_PULSE_USEC * 100UL / TESLA_DUTY_PERCENT)
+#if TESLA_PULSE_USEC * (F_CPU / 1000000UL) / 8 > 255
+#error "TESLA_PULSE_USEC is too long for the 8-bit pulse timer"
+#endif
+volatile byte *tesla_pin_port;
+volatile byte tesla_pin_mask;
+unsigned long tesla_pulse_start;                 /* when the last pulse started */
+unsigned long tesla_voice_next[AVAILABLE_TIMERS]; /* when each tone generator may pulse again */
+unsigned long tesla_duty_next;                   /* the duty limit's theoretical time */
+
+// The pulse timer runs at clk/8 in CTC mode, from 0 up to the pulse length, and is
+// stopped in between pulses.
+#if defined(__AVR_ATmega32U4__)
+#define TESLA_PULSE_VECT TIMER0_COMPA_vect
+#define TESLA_PULSE_START() { TCNT0 = 0; TCCR0B = 1 << CS01; }
+#define TESLA_PULSE_STOP() { TCCR0B = 0; }
+#elif defined(__AVR_ATmega8__)  // the one control register also has the mode
+#define TESLA_PULSE_VECT TIMER2_COMPA_vect
+#define TESLA_PULSE_START() { TCNT2 = 0; TCCR2 = (1 << WGM21) | (1 << CS21); }
+#define TESLA_PULSE_STOP() { TCCR2 = 1 << WGM21; }
+#else
+#define TESLA_PULSE_VECT TIMER2_COMPA_vect
+#define TESLA_PULSE_START() { TCNT2 = 0; TCCR2B = 1 << CS21; }
+#define TESLA_PULSE_STOP() { TCCR2B = 0; }
+#endif
+#endif
 
 volatile const byte *score_start = 0;
 volatile const byte *score_cursor = 0;
 volatile boolean Playtune::tune_playing = false;
+#if TUNE_HEADER
 boolean volume_present = ASSUME_VOLUME;
+#else
+#define volume_present ASSUME_VOLUME  /* without headers, all scores are alike */
+#endif
+
+struct tune_queue_entry_t {  // a score waiting to be played, with its header already read
+  const byte *start;         // the first command
+#if TUNE_HEADER
+  boolean volume;            // are there volume bytes?
+#endif
+#if TUNE_VERIFY
+  boolean fast;              // can it be played without checks?
+#endif
+} tune_queue_entries[TUNE_QUEUE_SIZE];
+volatile byte tune_queue_first = 0;  // the next one to play
+volatile byte tune_queue_count = 0;  // how many are waiting
+
+#if TUNE_VERIFY
+/* A score is checked once, when it is first played or queued, and what was found is
+  remembered for the last few scores. A good score whose voices all have tone generators
+  and whose notes are all in the frequency table is played by a copy of the interpreter
+  loop that doesn't check the commands again. */
+#define VERIFY_CACHE_SIZE 4
+#define VERIFY_MAX_LENGTH 0xfff0  /* bytes: a score that doesn't end by then runs off the end of flash */
+#define VERIFY_VOICES 0x1f        /* the verdict: how many voices the score uses, */
+#define VERIFY_PERCUSSION 0x20    /*   whether it has notes above 127, */
+#define VERIFY_BAD 0x80           /*   or that it is bad and won't be played */
+struct tune_verified_t {
+  const byte *start;         // the first command of the score
+  boolean volume;            //   and whether it has volume bytes
+  byte verdict;
+} tune_verified[VERIFY_CACHE_SIZE];
+byte tune_verified_next = 0;  // the entry to replace next
+boolean score_fast = false;   // is the score playing without checks?
+#endif
+
+#if TUNE_LINK
+/* Several boards can play one score. The leader plays the first voices on its own timers
+  and sends the commands for the others over a serial link, and each follower plays its
+  share of them. So that there is time for the bytes to get there, the leader sends each
+  moment of the score LINK_LEAD msec before it is due, with the time it is due, and plays
+  its own voices that much later. Times on the link are msec on the leader's clock, modulo
+  2^16. Every LINK_SYNC_INTERVAL msec the leader also sends the time, when the line is idle,
+  and the followers use these ticks to correct both the offset of their clocks and the
+  difference in their speed. The link messages, in hex, are:
+     A0 tt tt  sync tick: the leader's clock read tttt msec when it started sending this
+     B0 tt tt  the commands that follow are due at tttt msec
+     9t nn     play note nn on voice t
+     8t        stop voice t
+     F0        stop all the voices: the score ended or was stopped
+*/
+#define LINK_SYNC 0xa0
+#define LINK_MOMENT 0xb0
+#define LINK_LEAD 20            /* msec the leader sends moments before they are due */
+#define LINK_SYNC_INTERVAL 100  /* msec between sync ticks */
+#define LINK_RELOCK 2           /* msec: a follower whose clock is off by more than this starts over */
+#define LINK_MAX_RATE 0x800     /* the largest clock speed correction, in 2^-16: about 3% */
+#define LINK_EVENTS 32          /* how many commands a follower can hold until they are due */
+enum {LINK_NONE, LINK_LEADING, LINK_FOLLOWING};
+byte link_mode = LINK_NONE;
+Stream *link_stream;
+unsigned link_byte_ticks;           /* timer 1 ticks to send a byte, with its start and stop bits */
+// for the leader
+const byte *link_start;             /* the score the link is sending */
+const byte *link_cursor;            /* its next command, or 0 if it has all been sent */
+boolean link_volume;
+byte link_ahead;                    /* how many queued scores the link has started but the player hasn't */
+unsigned long link_moment;          /* timer 1 time when the next moment to send is due */
+uint16_t link_moment_msec;          /*   and the time on the link */
+unsigned long link_sync;            /* timer 1 time of the next sync tick */
+uint16_t link_sync_msec;            /*   and the time on the link */
+unsigned long link_deadline;        /* when the link next needs the alarm */
+unsigned long link_line_free;       /* when the bytes sent so far will have gone out */
+// for a follower
+byte link_first_voice;              /* the leader's voice that is our channel 0 */
+struct link_event_t {               /* a command waiting until it is due */
+  uint16_t msec;
+  byte cmd, note;
+} link_events[LINK_EVENTS];
+volatile byte link_events_first = 0;
+volatile byte link_events_count = 0;
+byte link_rx_cmd, link_rx_need;     /* the message being received, and how many more bytes it needs */
+uint16_t link_rx_value;
+uint16_t link_rx_msec;              /* when the commands being received are due */
+byte link_locked = 0;               /* how many sync ticks we have heard, up to 2 */
+unsigned long link_anchor;          /* timer 1 time of the last sync tick */
+uint16_t link_anchor_msec;          /*   and the time on the link */
+long link_rate = 0;                 /* our timer 1 ticks per leader msec are F_CPU/8000 * (1 + link_rate/2^16) */
+#endif
 
 // Table of midi note frequencies * 2
 //   They are times 2 for greater accuracy, yet still fit in a word.
@@ -376,11 +858,43 @@ const unsigned int PROGMEM tune_frequencies2_PGM[128] =
 
 void tune_playnote (byte chan, byte note);
 void tune_stopnote (byte chan);
+void tune_noteon (byte chan, byte note);
+void tune_noteoff (byte chan);
+#if TUNE_ARPEGGIO
+void tune_arpeggio_on (byte voice, byte note);
+void tune_arpeggio_off (byte voice);
+void tune_arpeggio_next (void);
+void tune_arpeggio_step (void);
+#endif
 void tune_stepscore (void);
+const byte *tune_skipheader (const byte *score, boolean *volume);
+void tune_startscore (const byte *start, boolean volume);
+boolean tune_queuestart (const byte *start, boolean volume);
+#if TUNE_VERIFY
+byte tune_checkscore (const byte *start, boolean volume);
+boolean tune_fastscore (byte verdict);
+#endif
+unsigned long tune_wait_now (void);
+void tune_wait_arm (void);
+void tune_sleep (void);
+#if TUNE_LINK
+void tune_link_begin (Stream *link, unsigned long baud, byte mode);
+void tune_link_startscore (const byte *start, boolean volume);
+void tune_link_lead (void);
+void tune_link_moment (void);
+void tune_link_send (byte b);
+void tune_link_stop (void);
+void tune_link_receive (byte b);
+void tune_link_sync (uint16_t msec);
+void tune_link_event (byte cmd, byte note);
+void tune_link_play (void);
+unsigned long tune_link_time (uint16_t msec);
+#endif
 
 #if TESLA_COIL
-void teslacoil_rising_edge(byte timernum);
-byte teslacoil_checknote(byte note);
+void teslacoil_init (void);
+void teslacoil_rising_edge (byte chan);
+byte teslacoil_checknote (byte note);
 #endif
 
 //------------------------------------------------------
@@ -391,6 +905,9 @@ void Playtune::tune_initchan(byte pin) {
   byte timer_num;
 
   if (_tune_num_chans < AVAILABLE_TIMERS) {
+#if TESLA_COIL
+    if (_tune_num_chans == 0) teslacoil_init();
+#endif
     timer_num = pgm_read_byte(tune_pin_to_timer_PGM + _tune_num_chans);
     _tune_pins[_tune_num_chans] = pin;
     _tune_num_chans++;
@@ -399,73 +916,65 @@ void Playtune::tune_initchan(byte pin) {
     Serial.print("init pin "); Serial.print(pin);
     Serial.print(" on timer "); Serial.println(timer_num);
 #endif
-    switch (timer_num) { // All timers are put in CTC mode
+    switch (timer_num) { // All timers but timer 1 are put in CTC mode
 
-#if !defined(__AVR_ATmega8__)
+#if TIMER_USED(0)
       case 0:  // 8 bit timer
         TCCR0A = 0;
         TCCR0B = 0;
         bitWrite(TCCR0A, WGM01, 1);
         bitWrite(TCCR0B, CS00, 1);
-        timer0_pin_port = portOutputRegister(digitalPinToPort(pin));
-        timer0_pin_mask = digitalPinToBitMask(pin);
+        TIMER_SET_PIN(0, pin);
         break;
 #endif
       case 1:  // 16 bit timer
         TCCR1A = 0;
         TCCR1B = 0;
-        bitWrite(TCCR1B, WGM12, 1);
-        bitWrite(TCCR1B, CS10, 1);
-        timer1_pin_port = portOutputRegister(digitalPinToPort(pin));
-        timer1_pin_mask = digitalPinToBitMask(pin);
-        tune_playnote (0, 60);  /* start and stop channel 0 (timer 1) on middle C so wait/delay works */
-        tune_stopnote (0);
+        bitWrite(TCCR1B, CS11, 1);  // normal mode, clk/8: it runs freely to time waits and delays
+        TIMER_SET_PIN(1, pin);
         break;
-#if !defined(__AVR_ATmega32U4__)
+#if TIMER_USED(2)
       case 2:  // 8 bit timer
         TCCR2A = 0;
         TCCR2B = 0;
         bitWrite(TCCR2A, WGM21, 1);
         bitWrite(TCCR2B, CS20, 1);
-        timer2_pin_port = portOutputRegister(digitalPinToPort(pin));
-        timer2_pin_mask = digitalPinToBitMask(pin);
+        TIMER_SET_PIN(2, pin);
         break;
 #endif
-#if defined(__AVR_ATmega1280__)||defined(__AVR_ATmega2560__)||defined(__AVR_ATmega32U4__)
+#if TIMER_USED(3)
       case 3:  // 16 bit timer
         TCCR3A = 0;
         TCCR3B = 0;
         bitWrite(TCCR3B, WGM32, 1); // CTC mode
         bitWrite(TCCR3B, CS30, 1);  // clk/1 (no prescaling)
-        timer3_pin_port = portOutputRegister(digitalPinToPort(pin));
-        timer3_pin_mask = digitalPinToBitMask(pin);
+        TIMER_SET_PIN(3, pin);
         break;
 #endif
-#if defined(__AVR_ATmega32U4__)
+#if TIMER_USED(4) && defined(__AVR_ATmega32U4__)
       case 4: // 10 bit timer, treated as 8 bit
         TCCR4A = 0;
         TCCR4B = 0;
         bitWrite(TCCR4B, CS40, 1); // clk/1 (no prescaling)
-        timer4_pin_port = portOutputRegister(digitalPinToPort(pin));
-        timer4_pin_mask = digitalPinToBitMask(pin);
+        TIMER_SET_PIN(4, pin);
         break;
 #endif
-#if defined(__AVR_ATmega1280__)||defined(__AVR_ATmega2560__)
+#if TIMER_USED(4) && (defined(__AVR_ATmega1280__)||defined(__AVR_ATmega2560__))
       case 4:  // 16 bit timer
         TCCR4A = 0;
         TCCR4B = 0;
         bitWrite(TCCR4B, WGM42, 1);
         bitWrite(TCCR4B, CS40, 1);
-        timer4_pin_port = portOutputRegister(digitalPinToPort(pin));
-        timer4_pin_mask = digitalPinToBitMask(pin);
+        TIMER_SET_PIN(4, pin);
         break;
+#endif
+#if TIMER_USED(5)
       case 5:  // 16 bit timer
         TCCR5A = 0;
         TCCR5B = 0;
         bitWrite(TCCR5B, WGM52, 1);
         bitWrite(TCCR5B, CS50, 1);
-        timer5_pin_port = portOutputRegister(digitalPinToPort(pin));
-        timer5_pin_mask = digitalPinToBitMask(pin);
+        TIMER_SET_PIN(5, pin);
         break;
 #endif
     }
@@ -477,6 +986,20 @@ void Playtune::tune_initchan(byte pin) {
 //-----------------------------------------------
 
 void tune_playnote (byte chan, byte note) {
+  // start a note from a score that hasn't been checked, or from a leader
+#if TUNE_ARPEGGIO
+  if (chan == TIMER1_CHAN || chan >= _tune_num_chans) {
+    tune_arpeggio_on(chan, note > 127 ? 127 : note);  // it takes turns on timer 1
+    return;
+  }
+#endif
+  if (chan < _tune_num_chans) {
+    if (note > 127) note = 127;
+    tune_noteon(chan, note);
+  }
+}
+
+void tune_noteon (byte chan, byte note) {
   byte timer_num;
   byte prescalarbits = 0b001;
   unsigned int frequency2; /* frequency times 2 */
@@ -489,137 +1012,138 @@ void tune_playnote (byte chan, byte note) {
   Serial.print(chan); Serial.print(' ');
   Serial.println(note, HEX);
 #endif
-  if (chan < _tune_num_chans) {
-    timer_num = pgm_read_byte(tune_pin_to_timer_PGM + chan);
+  timer_num = pgm_read_byte(tune_pin_to_timer_PGM + chan);
 #if TESLA_COIL
-    note = teslacoil_checknote(note);  // let teslacoil modify the note
+  note = teslacoil_checknote(note);  // let teslacoil modify the note
 #endif
-    if (note > 127) note = 127;
-    frequency2 = pgm_read_word (tune_frequencies2_PGM + note);
-    // The stuff below really needs a rewrite to avoid so many divisions and to
-    // make it easier to add new processors with different timer configurations!
-    if (timer_num == 0 || timer_num == 2
+  frequency2 = pgm_read_word (tune_frequencies2_PGM + note);
+  // The stuff below really needs a rewrite to avoid so many divisions and to
+  // make it easier to add new processors with different timer configurations!
+  if ((TIMER_USED(0) && timer_num == 0) || (TIMER_USED(2) && timer_num == 2)
 #if defined(__AVR_ATmega32U4__)
-        || timer_num == 4 // treat the 10-bit counter as an 8-bit counter
-#endif
-       ) { //***** 8 bit timer ******
-      if (note < ( F_CPU <= 8000000UL ? 12 : 24))
-        return;   //  too low to be playable
-      // scan through prescalars to find the best fit
-      ocr = F_CPU / frequency2 - 1;
-      prescalarbits = 0b001;  // ck/1: same for all timers
+      || (TIMER_USED(4) && timer_num == 4) // treat the 10-bit counter as an 8-bit counter
+#endif
+     ) { //***** 8 bit timer ******
+    if (note < ( F_CPU <= 8000000UL ? 12 : 24))
+      return;   //  too low to be playable
+    // scan through prescalars to find the best fit
+    ocr = F_CPU / frequency2 - 1;
+    prescalarbits = 0b001;  // ck/1: same for all timers
+    if (ocr > 255) {
+      ocr = F_CPU / frequency2 / 8 - 1;
+      prescalarbits = timer_num == 4 ? 0b0100 : 0b010;  // ck/8
+      if (timer_num == 2 && ocr > 255) {
+        ocr = F_CPU / frequency2 / 32 - 1;
+        prescalarbits = 0b011; // ck/32
+      }
       if (ocr > 255) {
-        ocr = F_CPU / frequency2 / 8 - 1;
-        prescalarbits = timer_num == 4 ? 0b0100 : 0b010;  // ck/8
+        ocr = F_CPU / frequency2 / 64 - 1;
+        prescalarbits = timer_num == 0 ? 0b011 : (timer_num == 4 ? 0b0111 : 0b100);  // ck/64
         if (timer_num == 2 && ocr > 255) {
-          ocr = F_CPU / frequency2 / 32 - 1;
-          prescalarbits = 0b011; // ck/32
+          ocr = F_CPU / frequency2 / 128 - 1;
+          prescalarbits = 0b101; // ck/128
         }
         if (ocr > 255) {
-          ocr = F_CPU / frequency2 / 64 - 1;
-          prescalarbits = timer_num == 0 ? 0b011 : (timer_num == 4 ? 0b0111 : 0b100);  // ck/64
-          if (timer_num == 2 && ocr > 255) {
-            ocr = F_CPU / frequency2 / 128 - 1;
-            prescalarbits = 0b101; // ck/128
-          }
+          ocr = F_CPU / frequency2 / 256 - 1;
+          prescalarbits = timer_num == 0 ? 0b100 : (timer_num == 4 ? 0b1001 : 0b110); // clk/256
           if (ocr > 255) {
-            ocr = F_CPU / frequency2 / 256 - 1;
-            prescalarbits = timer_num == 0 ? 0b100 : (timer_num == 4 ? 0b1001 : 0b110); // clk/256
-            if (ocr > 255) {
-              // can't do any better than /1024
-              ocr = F_CPU / frequency2 / 1024 - 1;
-              prescalarbits = timer_num == 0 ? 0b101 : (timer_num == 4 ? 0b1011 : 0b111); // clk/1024
-            }
+            // can't do any better than /1024
+            ocr = F_CPU / frequency2 / 1024 - 1;
+            prescalarbits = timer_num == 0 ? 0b101 : (timer_num == 4 ? 0b1011 : 0b111); // clk/1024
           }
         }
       }
-#if !defined(__AVR_ATmega8__)
-      if (timer_num == 0) TCCR0B = (TCCR0B & 0b11111000) | prescalarbits;
-#if defined(__AVR_ATmega32U4__)
-      else if (timer_num == 4) {
-        TCCR4B = (TCCR4B & 0b11110000) | prescalarbits;
-      }
+    }
+#if TIMER_USED(0)
+    if (timer_num == 0) TCCR0B = (TCCR0B & 0b11111000) | prescalarbits;
 #endif
-      else { // must be timer_num == 2
+#if TIMER_USED(4) && defined(__AVR_ATmega32U4__)
+    if (timer_num == 4) TCCR4B = (TCCR4B & 0b11110000) | prescalarbits;
 #endif
-#if !defined(__AVR_ATmega32U4__)
-        TCCR2B = (TCCR2B & 0b11111000) | prescalarbits;
+#if TIMER_USED(2)
+    if (timer_num == 2) TCCR2B = (TCCR2B & 0b11111000) | prescalarbits;
 #endif
-      }
+  }
+  else if (timer_num == 1 || !OTHER_16BIT_TIMERS) { //***** 16-bit timer 1, which never changes its prescaler
+    ocr = (F_CPU / 8 + frequency2 / 2) / frequency2;  // ticks per half period, rounded
+    if (ocr > 0xffff)
+      return;  //  too low to be playable: below note 11 with a 16 Mhz clock
+  }
+  else  //******  other 16-bit timers  *********
+  { // two choices for the 16 bit timers: ck/1 or ck/64
+    ocr = F_CPU / frequency2 - 1;
+    prescalarbits = 0b001;
+    if (ocr > 0xffff) {
+      ocr = F_CPU / frequency2 / 64 - 1;
+      prescalarbits = 0b011;
     }
-    else  //******  16-bit timer  *********
-    { // two choices for the 16 bit timers: ck/1 or ck/64
-      ocr = F_CPU / frequency2 - 1;
-      prescalarbits = 0b001;
-      if (ocr > 0xffff) {
-        ocr = F_CPU / frequency2 / 64 - 1;
-        prescalarbits = 0b011;
-      }
-      if (timer_num == 1) TCCR1B = (TCCR1B & 0b11111000) | prescalarbits;
-#if defined(__AVR_ATmega1280__)||defined(__AVR_ATmega2560__)||defined(__AVR_ATmega32U4__)
-      else if (timer_num == 3) TCCR3B = (TCCR3B & 0b11111000) | prescalarbits;
+#if TIMER_USED(3)
+    if (timer_num == 3) TCCR3B = (TCCR3B & 0b11111000) | prescalarbits;
 #endif
-#if defined(__AVR_ATmega1280__)||defined(__AVR_ATmega2560__)
-      else if (timer_num == 4) TCCR4B = (TCCR4B & 0b11111000) | prescalarbits;
-      else if (timer_num == 5) TCCR5B = (TCCR5B & 0b11111000) | prescalarbits;
+#if TIMER_USED(4) && (defined(__AVR_ATmega1280__)||defined(__AVR_ATmega2560__))
+    if (timer_num == 4) TCCR4B = (TCCR4B & 0b11111000) | prescalarbits;
 #endif
-    }
+#if TIMER_USED(5)
+    if (timer_num == 5) TCCR5B = (TCCR5B & 0b11111000) | prescalarbits;
+#endif
+#if !OTHER_16BIT_TIMERS
+    (void) prescalarbits;  // only timer 1 plays notes, and this is never reached
+#endif
+  }
 
-    // Set the OCR for the timer, zero the counter, then turn on the interrupts
-    switch (timer_num) {
-#if !defined(__AVR_ATmega8__)
-      case 0:
-        OCR0A = ocr;
-        TCNT0 = 0;
-        bitWrite(TIMSK0, OCIE0A, 1);
-        break;
+  // Set the OCR for the timer, zero the counter, then turn on the interrupts
+  switch (timer_num) {
+#if TIMER_USED(0)
+    case 0:
+      OCR0A = ocr;
+      TCNT0 = 0;
+      bitWrite(TIMSK0, OCIE0A, 1);
+      break;
 #endif
-      case 1:
-        OCR1A = ocr;
-        TCNT1 = 0;
-        wait_timer_frequency2 = frequency2;  // for "tune_delay" function
-        wait_timer_playing = true;
-        bitWrite(TIMSK1, OCIE1A, 1);
-        break;
-#if !defined(__AVR_ATmega32U4__)
-      case 2:
-        OCR2A = ocr;
-        TCNT2 = 0;
-        bitWrite(TIMSK2, OCIE2A, 1);
-        break;
+    case 1:  // don't touch the counter, which is timing the score: just schedule the first toggle
+      timer1_half_period = ocr;
+      OCR1A = TCNT1 + timer1_half_period;
+      TIFR1 = 1 << OCF1A;  // forget any old match
+      bitWrite(TIMSK1, OCIE1A, 1);
+      break;
+#if TIMER_USED(2)
+    case 2:
+      OCR2A = ocr;
+      TCNT2 = 0;
+      bitWrite(TIMSK2, OCIE2A, 1);
+      break;
 #endif
-#if defined(__AVR_ATmega1280__)||defined(__AVR_ATmega2560__)||(__AVR_ATmega32U4__)
-      case 3:
-        OCR3A = ocr;
-        TCNT3 = 0;
-        bitWrite(TIMSK3, OCIE3A, 1);
-        break;
-#if defined(__AVR_ATmega1280__)||defined(__AVR_ATmega2560__)
-      case 4:
-        OCR4A = ocr;
-        TCNT4 = 0;
-        bitWrite(TIMSK4, OCIE4A, 1);
-        break;
+#if TIMER_USED(3)
+    case 3:
+      OCR3A = ocr;
+      TCNT3 = 0;
+      bitWrite(TIMSK3, OCIE3A, 1);
+      break;
 #endif
-#if defined(__AVR_ATmega32U4__)
-      case 4:// TOP value compare for this 10-bit register is in C!
-        OCR4C = ocr / 2 + 1; //timer4 doesn't have CTC mode, but I don't understand the f/2
-        // others have reported problems too, and apparently the chip as has bugs.
-        // http://forum.arduino.cc/index.php?topic=261869.0
-        // http://electronics.stackexchange.com/questions/245661/atmega32u4-generate-clock-using-timer4
-        TCNT4 = 0;
-        bitWrite(TIMSK4, OCIE4A, 1);
-        break;
+#if TIMER_USED(4) && (defined(__AVR_ATmega1280__)||defined(__AVR_ATmega2560__))
+    case 4:
+      OCR4A = ocr;
+      TCNT4 = 0;
+      bitWrite(TIMSK4, OCIE4A, 1);
+      break;
 #endif
-#if defined(__AVR_ATmega1280__)||defined(__AVR_ATmega2560__)
-      case 5:
-        OCR5A = ocr;
-        TCNT5 = 0;
-        bitWrite(TIMSK5, OCIE5A, 1);
-        break;
+#if TIMER_USED(4) && defined(__AVR_ATmega32U4__)
+    case 4:// TOP value compare for this 10-bit register is in C!
+      OCR4C = ocr / 2 + 1; //timer4 doesn't have CTC mode, but I don't understand the f/2
+      // others have reported problems too, and apparently the chip as has bugs.
+      // http://forum.arduino.cc/index.php?topic=261869.0
+      // http://electronics.stackexchange.com/questions/245661/atmega32u4-generate-clock-using-timer4
+      TCNT4 = 0;
+      bitWrite(TIMSK4, OCIE4A, 1);
+      break;
 #endif
+#if TIMER_USED(5)
+    case 5:
+      OCR5A = ocr;
+      TCNT5 = 0;
+      bitWrite(TIMSK5, OCIE5A, 1);
+      break;
 #endif
-    }
   }
 }
 
@@ -628,6 +1152,16 @@ void tune_playnote (byte chan, byte note) {
 //-----------------------------------------------
 
 void tune_stopnote (byte chan) {
+#if TUNE_ARPEGGIO
+  if (chan == TIMER1_CHAN || chan >= _tune_num_chans) {
+    tune_arpeggio_off(chan);
+    return;
+  }
+#endif
+  if (chan < _tune_num_chans) tune_noteoff(chan);  // not one of ours, like tune_playnote()
+}
+
+void tune_noteoff (byte chan) {
   byte timer_num;
 
 #if DBUG
@@ -635,65 +1169,290 @@ void tune_stopnote (byte chan) {
   Serial.println(chan, DEC);
 #endif
 
+  if (chan >= AVAILABLE_TIMERS) return;  // no such tone generator
   timer_num = pgm_read_byte(tune_pin_to_timer_PGM + chan);
   switch (timer_num) {
-#if !defined(__AVR_ATmega8__)
+#if TIMER_USED(0)
     case 0:
       TIMSK0 &= ~(1 << OCIE0A);                 // disable the interrupt
-      *timer0_pin_port &= ~(timer0_pin_mask);   // keep pin low after stop
+      TIMER_PORT(0) &= ~TIMER_MASK(0);          // keep pin low after stop
       break;
 #endif
     case 1:
-      // We leave the timer1 interrupt running for timing delays and score waits
-      wait_timer_playing = false;
-      *timer1_pin_port &= ~(timer1_pin_mask);   // keep pin low after stop
+      // The timer keeps running for timing delays and score waits
+      TIMSK1 &= ~(1 << OCIE1A);                 // disable the note's interrupt
+      TIMER_PORT(1) &= ~TIMER_MASK(1);          // keep pin low after stop
       break;
-#if !defined(__AVR_ATmega32U4__)
+#if TIMER_USED(2)
     case 2:
-      TIMSK2 &= ~(1 << OCIE1A);                 // disable the interrupt
-      *timer2_pin_port &= ~(timer2_pin_mask);   // keep pin low after stop
+      TIMSK2 &= ~(1 << OCIE2A);                 // disable the interrupt
+      TIMER_PORT(2) &= ~TIMER_MASK(2);          // keep pin low after stop
       break;
 #endif
-#if defined(__AVR_ATmega1280__)||defined(__AVR_ATmega2560__)||defined(__AVR_ATmega32U4__)
+#if TIMER_USED(3)
     case 3:
       TIMSK3 &= ~(1 << OCIE3A);                 // disable the interrupt
-      *timer3_pin_port &= ~(timer3_pin_mask);   // keep pin low after stop
+      TIMER_PORT(3) &= ~TIMER_MASK(3);          // keep pin low after stop
       break;
+#endif
+#if TIMER_USED(4)
     case 4:
       TIMSK4 &= ~(1 << OCIE4A);                 // disable the interrupt
-      *timer4_pin_port &= ~(timer4_pin_mask);   // keep pin low after stop
+      TIMER_PORT(4) &= ~TIMER_MASK(4);          // keep pin low after stop
       break;
 #endif
-#if defined(__AVR_ATmega1280__)||defined(__AVR_ATmega2560__)
+#if TIMER_USED(5)
     case 5:
       TIMSK5 &= ~(1 << OCIE5A);                 // disable the interrupt
-      *timer5_pin_port &= ~(timer5_pin_mask);   // keep pin low after stop
+      TIMER_PORT(5) &= ~TIMER_MASK(5);          // keep pin low after stop
       break;
 #endif
   }
 }
 
+#if TUNE_ARPEGGIO
+//-----------------------------------------------
+// Notes that take turns on timer 1
+//-----------------------------------------------
+
+void tune_arpeggio_on (byte voice, byte note) {
+  // Start a note for timer 1's voice, or for one that has no tone generator
+  unsigned int frequency2;
+  unsigned long ticks;
+
+  if (_tune_num_chans == 0) return;
+#if TUNE_LINK
+  if (link_mode == LINK_LEADING && voice != TIMER1_CHAN) return;  // a follower plays it
+#endif
+#if TESLA_COIL
+  note = teslacoil_checknote(note);
+#endif
+  frequency2 = pgm_read_word (tune_frequencies2_PGM + note);
+  ticks = (F_CPU / 8 + frequency2 / 2) / frequency2;  // as tune_noteon() does for timer 1
+  if (ticks > 0xffff)
+    return;  // too low to be playable
+  arp_half_period[voice] = ticks;
+  arp_voices |= (uint16_t)1 << voice;
+  arp_current = voice;  // a new note is heard right away
+  arp_deadline = tune_wait_now() + ARP_TICKS;
+  timer1_half_period = ticks;
+  if (arp_voices == ((uint16_t)1 << voice)) {  // it's alone: start it as tune_noteon() would
+    OCR1A = TCNT1 + timer1_half_period;
+    TIFR1 = 1 << OCF1A;
+    bitWrite(TIMSK1, OCIE1A, 1);
+  }
+}
+
+void tune_arpeggio_off (byte voice) {
+  // Stop the note of a voice on timer 1, and give its turn to the next one
+  arp_voices &= ~((uint16_t)1 << voice);
+  if (!arp_voices) {
+    if (_tune_num_chans) tune_noteoff(TIMER1_CHAN);
+  }
+  else if (voice == arp_current) {
+    tune_arpeggio_next();
+    arp_deadline = tune_wait_now() + ARP_TICKS;
+  }
+}
+
+void tune_arpeggio_next (void) {
+  // Give timer 1 to the next voice that has a note
+  byte voice = arp_current;
+  uint16_t bit = (uint16_t)1 << voice;
+  do {
+    bit <<= 1;
+    if (++voice >= ARP_VOICES) {
+      voice = 0;
+      bit = 1;
+    }
+  } while (!(arp_voices & bit));
+  arp_current = voice;
+  timer1_half_period = arp_half_period[voice];
+}
+
+void tune_arpeggio_step (void) {
+  // The alarm went off for the next turn
+  tune_arpeggio_next();
+  arp_deadline += ARP_TICKS;
+  if ((long)(arp_deadline - tune_wait_now()) <= WAIT_MARGIN)  // we fell behind: start over from now
+    arp_deadline = tune_wait_now() + ARP_TICKS;
+}
+#endif
+
 //-----------------------------------------------
 // Start playing a score
 //-----------------------------------------------
 
 void Playtune::tune_playscore (const byte *score) {
+  boolean volume;
+  score = tune_skipheader(score, &volume);
+#if TUNE_VERIFY
+  if (tune_checkscore(score, volume) & VERIFY_BAD) return;  // refuse it, and leave the current one playing
+#endif
   if (tune_playing) tune_stopscore();
-  score_start = score;
-  volume_present = ASSUME_VOLUME;
+  tune_startscore(score, volume);
+}
 
-  // look for the optional file header
+const byte *tune_skipheader (const byte *score, boolean *volume) {
+  // look for the optional file header, and return where the commands start
+  *volume = ASSUME_VOLUME;
+#if TUNE_HEADER
+  file_hdr_t file_header;
   memcpy_P(&file_header, score, sizeof(file_hdr_t)); // copy possible header from PROGMEM to RAM
   if (file_header.id1 == 'P' && file_header.id2 == 't') { // validate it
-    volume_present = file_header.f1 & HDR_F1_VOLUME_PRESENT;
+    *volume = file_header.f1 & HDR_F1_VOLUME_PRESENT;
 #if DBUG
-    Serial.print("header: volume_present="); Serial.println(volume_present);
+    Serial.print("header: volume_present="); Serial.println(*volume);
+#endif
+    score += file_header.hdr_length; // skip the whole header
+  }
 #endif
-    score_start += file_header.hdr_length; // skip the whole header
+  return score;
+}
+
+#if TUNE_VERIFY
+boolean Playtune::tune_verify (const byte *score) {
+  boolean volume;
+  score = tune_skipheader(score, &volume);
+  return !(tune_checkscore(score, volume) & VERIFY_BAD);
+}
+
+byte tune_checkscore (const byte *start, boolean volume) {
+  // Check the commands of a score in one pass, or remember what we found before.
+  const byte *cursor = start;
+  byte i, cmd, verdict = 0;
+  boolean waited = false;  // has time passed since the start?
+
+  for (i = 0; i < VERIFY_CACHE_SIZE; ++i)
+    if (tune_verified[i].start == start && tune_verified[i].volume == volume)
+      return tune_verified[i].verdict;
+  while (1) {
+    if ((unsigned) (cursor - start) >= VERIFY_MAX_LENGTH) { // it never ends
+      verdict = VERIFY_BAD;
+      break;
+    }
+    cmd = pgm_read_byte(cursor++);
+    if (cmd < 0x80) { // a wait
+      if (cmd || pgm_read_byte(cursor)) waited = true;
+      ++cursor;
+      continue;
+    }
+    if ((cmd & 0xf0) == CMD_PLAYNOTE || (cmd & 0xf0) == CMD_STOPNOTE) {
+      if ((cmd & 0x0f) >= (verdict & VERIFY_VOICES))
+        verdict = (verdict & ~VERIFY_VOICES) | ((cmd & 0x0f) + 1);
+      if ((cmd & 0xf0) == CMD_STOPNOTE) continue;
+      if (pgm_read_byte(cursor++) > 127) verdict |= VERIFY_PERCUSSION;
+      if (volume && pgm_read_byte(cursor++) > 127) { // not a volume: the header was wrong
+        verdict = VERIFY_BAD;
+        break;
+      }
+    }
+    else if ((cmd & 0xf0) == CMD_INSTRUMENT) ++cursor;
+    else if ((cmd & 0xf0) == CMD_STOP) break;  // it ends here
+    else if ((cmd & 0xf0) == CMD_RESTART) {  // it ends here, unless it would loop forever at once
+      if (!waited) verdict = VERIFY_BAD;
+      break;
+    }
+    // tune_stepscore() ignores anything else
   }
+#if DBUG
+  Serial.print("score checked: verdict "); Serial.println(verdict, HEX);
+#endif
+  tune_verified[tune_verified_next].start = start;
+  tune_verified[tune_verified_next].volume = volume;
+  tune_verified[tune_verified_next].verdict = verdict;
+  if (++tune_verified_next >= VERIFY_CACHE_SIZE) tune_verified_next = 0;
+  return verdict;
+}
+
+boolean tune_fastscore (byte verdict) {
+  // can a score with this verdict be played without checks, with the tone generators we have?
+  return !(verdict & (VERIFY_BAD | VERIFY_PERCUSSION)) && (verdict & VERIFY_VOICES) <= _tune_num_chans;
+}
+#endif
+
+void tune_startscore (const byte *start, boolean volume) {
+#if TUNE_VERIFY
+  boolean fast = tune_fastscore(tune_checkscore(start, volume));
+#endif
+#if !TUNE_LINK && !TUNE_VERIFY && !TUNE_HEADER
+  (void) volume;  // every score is read alike, and nothing else needs to know
+#endif
+  noInterrupts();
+  score_start = start;
+#if TUNE_HEADER
+  volume_present = volume;
+#endif
+#if TUNE_ARPEGGIO
+  arp_voices = 0;  /* the old score's notes don't take turns with the new ones */
+#endif
+#if TUNE_VERIFY
+  score_fast = fast;
+#endif
   score_cursor = score_start;
-  tune_stepscore();  /* execute initial commands */
-  Playtune::tune_playing = true;  /* release the interrupt routine */
+  if (!(TIMSK1 & (1 << OCIE1B))) wait_base = TCNT1;  /* the alarm is off, so start a new timeline */
+  score_deadline = tune_wait_now();
+  Playtune::tune_playing = true;
+#if TUNE_LINK
+  if (link_mode == LINK_LEADING) {  /* tell the followers about the first moment, and play it later */
+    score_deadline += LINK_LEAD * (F_CPU / 8000UL);
+    tune_link_startscore(start, volume);
+    tune_wait_arm();
+    interrupts();
+    return;
+  }
+#endif
+  tune_stepscore();  /* execute initial commands, and set the alarm for the first wait */
+  interrupts();
+}
+
+//-----------------------------------------------
+// Queue a score to play when the current one ends
+//-----------------------------------------------
+
+boolean Playtune::tune_queue (const byte *score) {
+  boolean volume;
+  score = tune_skipheader(score, &volume);  // do it now, not in the interrupt routine
+  return tune_queuestart(score, volume);
+}
+
+boolean Playtune::tune_queue (const tune_catalog_t *entry) {
+  tune_catalog_t catalog;
+  memcpy_P(&catalog, entry, sizeof(tune_catalog_t)); // copy the entry from PROGMEM to RAM
+  return tune_queuestart(catalog.score + catalog.hdr_length, (catalog.f1 & HDR_F1_VOLUME_PRESENT) != 0);
+}
+
+byte Playtune::tune_queued (void) {
+  return tune_queue_count;
+}
+
+boolean tune_queuestart (const byte *start, boolean volume) {
+#if TUNE_VERIFY
+  byte verdict = tune_checkscore(start, volume);
+  if (verdict & VERIFY_BAD) return false;
+#endif
+  noInterrupts();  // so the score can't end while we look
+  if (!Playtune::tune_playing) { // nothing to wait for, so start it now
+    interrupts();
+    tune_startscore(start, volume);
+    return true;
+  }
+  if (tune_queue_count >= TUNE_QUEUE_SIZE) {
+    interrupts();
+    return false;
+  }
+  byte i = tune_queue_first + tune_queue_count;
+  if (i >= TUNE_QUEUE_SIZE) i -= TUNE_QUEUE_SIZE;
+  tune_queue_entries[i].start = start;
+#if TUNE_HEADER
+  tune_queue_entries[i].volume = volume;
+#endif
+#if TUNE_VERIFY
+  tune_queue_entries[i].fast = tune_fastscore(verdict);
+#endif
+  ++tune_queue_count;
+  interrupts();
+  return true;
 }
 
 void tune_stepscore (void) {
@@ -703,25 +1462,58 @@ void tune_stepscore (void) {
     This is called initially from tune_playcore, but then is called
     from the interrupt routine when waits expire.
   */
-#define CMD_PLAYNOTE	0x90	/* play a note: low nibble is generator #, note is next byte */
-#define CMD_STOPNOTE	0x80	/* stop a note: low nibble is generator # */
-#define CMD_INSTRUMENT  0xc0 /* change instrument; low nibble is generator #, instrument is next byte */
-#define CMD_RESTART	0xe0	/* restart the score from the beginning */
-#define CMD_STOP	0xf0	/* stop playing */
-  /* if CMD < 0x80, then the other 7 bits and the next byte are a 15-bit big-endian number of msec to wait */
+
+#if TUNE_LINK
+  if (link_mode == LINK_FOLLOWING) {  /* our score is what the leader sends */
+    tune_link_play();
+    return;
+  }
+#endif
+
+#if TUNE_VERIFY
+  if (score_fast) {  /* a checked score: the same, but without checking the channels and notes */
+    while (1) {
+      cmd = pgm_read_byte(score_cursor++);
+      if (cmd < 0x80) {
+        duration = ((unsigned)cmd << 8) | (pgm_read_byte(score_cursor++));
+        score_deadline += (unsigned long) duration * (F_CPU / 8000UL);
+        if ((long)(score_deadline - tune_wait_now()) > WAIT_MARGIN) {
+          tune_wait_arm();
+          return;
+        }
+        continue;
+      }
+      opcode = cmd & 0xf0;
+      chan = cmd & 0x0f;
+      if (opcode == CMD_STOPNOTE) tune_noteoff(chan);
+      else if (opcode == CMD_PLAYNOTE) {
+        note = pgm_read_byte(score_cursor++);
+        if (volume_present) ++score_cursor;
+        tune_noteon(chan, note);
+      }
+      else if (opcode == CMD_INSTRUMENT) score_cursor++;
+      else if (opcode == CMD_RESTART) score_cursor = score_start;
+      else {  /* the end: the loop below stops, or goes on to the next queued score */
+        --score_cursor;
+        break;
+      }
+    }
+  }
+#endif
 
   while (1) {
     cmd = pgm_read_byte(score_cursor++);
     if (cmd < 0x80) { /* wait count in msec. */
       duration = ((unsigned)cmd << 8) | (pgm_read_byte(score_cursor++));
-      wait_toggle_count = ((unsigned long) wait_timer_frequency2 * duration + 500) / 1000;
-      if (wait_toggle_count == 0) wait_toggle_count = 1;
+      score_deadline += (unsigned long) duration * (F_CPU / 8000UL);  // timer 1 ticks
 #if DBUG
       Serial.print("wait "); Serial.print(duration);
-      Serial.print("ms, cnt ");
-      Serial.print(wait_toggle_count); Serial.print(" freq "); Serial.println(wait_timer_frequency2);
+      Serial.print("ms, deadline ");
+      Serial.println(score_deadline);
 #endif
-      break;
+      if ((long)(score_deadline - tune_wait_now()) > WAIT_MARGIN)
+        break;
+      continue;  // it's over already: a short wait after we were late
     }
     opcode = cmd & 0xf0;
     chan = cmd & 0x0f;
@@ -740,10 +1532,37 @@ void tune_stepscore (void) {
       score_cursor = score_start;
     }
     else if (opcode == CMD_STOP) { /* stop score */
+      if (tune_queue_count) { /* but go right on to the next one in the queue */
+#if TUNE_ARPEGGIO
+        arp_voices = 0;
+#endif
+        for (chan = 0; chan < _tune_num_chans; ++chan)
+          tune_stopnote(chan);
+        score_start = tune_queue_entries[tune_queue_first].start;
+#if TUNE_HEADER
+        volume_present = tune_queue_entries[tune_queue_first].volume;
+#endif
+#if TUNE_VERIFY
+        score_fast = tune_queue_entries[tune_queue_first].fast;
+#endif
+        score_cursor = score_start;
+        if (++tune_queue_first >= TUNE_QUEUE_SIZE) tune_queue_first = 0;
+        --tune_queue_count;
+#if TUNE_LINK
+        if (link_ahead) --link_ahead;  /* the followers already know about it */
+        else if (link_mode == LINK_LEADING) { /* it was queued too late: tell them now */
+          link_start = link_cursor = (const byte *) score_start;
+          link_volume = volume_present;
+          tune_link_lead();
+        }
+#endif
+        continue;
+      }
       Playtune::tune_playing = false;
       break;
     }
   }
+  tune_wait_arm();  // for the wait, or turn the alarm off if nothing needs it
 }
 
 //-----------------------------------------------
@@ -752,11 +1571,75 @@ void tune_stepscore (void) {
 
 void Playtune::tune_stopscore (void) {
   int i;
+  noInterrupts();
+  tune_queue_count = 0;  // forget the queued scores too
+#if TUNE_ARPEGGIO
+  arp_voices = 0;  // so stopping timer 1's voice stops timer 1
+#endif
   for (i = 0; i < _tune_num_chans; ++i)
     tune_stopnote(i);
+#if TUNE_LINK
+  if (link_mode == LINK_LEADING && Playtune::tune_playing) tune_link_stop();
+  link_events_count = 0;
+#endif
   Playtune::tune_playing = false;
+  tune_wait_arm();
+  interrupts();
 }
 
+//-----------------------------------------------
+// The wait timer's alarm
+//-----------------------------------------------
+
+unsigned long tune_wait_now (void) {
+  // The current time on the 32-bit extension of timer 1. This is right as long as
+  // less than a whole turn of the counter has passed since the alarm was set,
+  // which is always true while the alarm is on. Call it with interrupts off.
+  return wait_base + (uint16_t)(TCNT1 - (uint16_t)wait_base);
+}
+
+void tune_wait_arm (void) {
+  // Set the compare B alarm for the end of the score wait or the delay, the leader's
+  // next link deadline, or the next arpeggio turn, whichever is first, or for the
+  // longest alarm if that is still too far away. The deadlines that have already
+  // arrived are left for tune_stepscore() or tune_delay() to notice. Turn the alarm
+  // off if neither a score nor a delay needs it, nor a follower's clock.
+  // Call this from the interrupt routine, or with interrupts off.
+  unsigned long left = WAIT_MAX_ALARM;
+  long until;
+  wait_base = tune_wait_now();
+#if TUNE_LINK
+  if (!Playtune::tune_playing && !doing_delay && link_mode != LINK_FOLLOWING) {
+#else
+  if (!Playtune::tune_playing && !doing_delay) {
+#endif
+    TIMSK1 &= ~(1 << OCIE1B);
+    return;
+  }
+  until = score_deadline - wait_base;
+  if (Playtune::tune_playing && until > WAIT_MARGIN && (unsigned long) until < left) left = until;
+#if TUNE_DELAY
+  until = delay_deadline - wait_base;
+  if (doing_delay && until > WAIT_MARGIN && (unsigned long) until < left) left = until;
+#endif
+#if TUNE_LINK
+  until = link_deadline - wait_base;
+  if (link_mode == LINK_LEADING && Playtune::tune_playing
+      && until > WAIT_MARGIN && (unsigned long) until < left) left = until;
+#endif
+#if TUNE_ARPEGGIO
+  until = arp_deadline - wait_base;
+  if (Playtune::tune_playing && ARP_SHARING
+      && until > WAIT_MARGIN && (unsigned long) until < left) left = until;
+#endif
+  OCR1B = (uint16_t)(wait_base + left);
+  if (!(TIMSK1 & (1 << OCIE1B))) {
+    TIFR1 = 1 << OCF1B;  // forget any old match
+    TIMSK1 |= 1 << OCIE1B;
+  }
+}
+
+#if TUNE_DELAY
 //-----------------------------------------------
 // Delay a specified number of milliseconds
 //-----------------------------------------------
@@ -764,24 +1647,320 @@ void Playtune::tune_stopscore (void) {
 void Playtune::tune_delay (unsigned duration) {
 
   // We provide this because using timer 0 breaks the Arduino delay() function.
-  // Compute the toggle count based on whatever frequency the timer used for
-  // score waits is running at.  If the frequency of that timer changes, the
-  // toggle count will be adjusted by the interrupt routine.
+  // The delay is timed by the same alarm as the score waits, and we sleep until it ends.
 
-  boolean notdone;
+  if (!(TCCR1B & ((1 << CS12) | (1 << CS11) | (1 << CS10)))) return;  // timer 1 was never started
   noInterrupts();
-  delay_toggle_count = ((unsigned long) wait_timer_frequency2 * duration + 500) / 1000;
+  if (!(TIMSK1 & (1 << OCIE1B))) wait_base = TCNT1;  // the alarm is off, so start a new timeline
+  delay_deadline = tune_wait_now() + (unsigned long) duration * (F_CPU / 8000UL);
   doing_delay = true;
+  tune_wait_arm();
+  while ((long)(delay_deadline - tune_wait_now()) > WAIT_MARGIN)
+    tune_sleep();
+  doing_delay = false;
+  tune_wait_arm();
   interrupts();
-  do { // wait until the interrupt routines decrements the toggle count to zero
-    noInterrupts();
-    notdone = delay_toggle_count != 0;  /* interrupt-safe test */
-    interrupts();
+}
+#endif
+
+//-----------------------------------------------
+// Sleep until the next interrupt
+//-----------------------------------------------
+
+void Playtune::tune_idle (void) {
+  noInterrupts();
+#if TUNE_LINK
+  if (tune_playing || link_mode == LINK_FOLLOWING) tune_sleep();  // otherwise we might not wake up
+#else
+  if (tune_playing) tune_sleep();  // otherwise we might not wake up
+#endif
+  interrupts();
+}
+
+void tune_sleep (void) {
+  // Call this with interrupts off, and with the wait timer's alarm on;
+  // interrupts are off again when it returns.
+  // The instruction after the one that enables interrupts is always executed
+  // before any interrupt is taken, so an interrupt can't sneak in before we
+  // go to sleep and leave us sleeping with nothing left to wake us.
+  // The alarm will wake us before the counter makes a whole turn, so we can
+  // measure the sleep with it.
+  unsigned long start = tune_wait_now();
+  set_sleep_mode(SLEEP_MODE_IDLE);  // the timers keep running
+  sleep_enable();
+  interrupts();
+  sleep_cpu();
+  sleep_disable();
+  noInterrupts();
+  sleep_cycles += (tune_wait_now() - start) << 3;  // timer 1 counts at F_CPU/8
+}
+
+unsigned long Playtune::tune_sleepcycles (boolean reset) {
+  unsigned long cycles = sleep_cycles;
+  if (reset) sleep_cycles = 0;
+  return cycles;
+}
+
+#if TUNE_LINK
+//-----------------------------------------------
+// Play a score on several boards
+//-----------------------------------------------
+
+void Playtune::tune_lead (Stream *link, unsigned long baud) {
+  tune_stopscore();
+  tune_link_begin(link, baud, LINK_LEADING);
+}
+
+void Playtune::tune_follow (Stream *link, unsigned long baud, byte first_voice) {
+  tune_stopscore();
+  link_first_voice = first_voice;
+  tune_link_begin(link, baud, LINK_FOLLOWING);
+}
+
+void tune_link_begin (Stream *link, unsigned long baud, byte mode) {
+  noInterrupts();
+  link_stream = link;
+  link_mode = link ? mode : (byte) LINK_NONE;
+  if (link) link_byte_ticks = (F_CPU / 8 * 10) / baud;  // 10 bits per byte
+  link_cursor = 0;
+  link_rx_need = 0;
+  link_locked = 0;
+  if (!(TIMSK1 & (1 << OCIE1B))) wait_base = TCNT1;  /* the alarm is off, so start a new timeline */
+  tune_wait_arm();  /* a follower keeps it on from now on */
+  interrupts();
+}
+
+void tune_link_startscore (const byte *start, boolean volume) {
+  // Start sending a score to the followers. Its first moment is LINK_LEAD msec from now.
+  // Call this with interrupts off.
+  unsigned long now = tune_wait_now();
+  link_start = link_cursor = start;
+  link_volume = volume;
+  link_ahead = 0;
+  link_line_free = now;
+  link_sync = now;  // send a sync tick first
+  link_sync_msec += 0x4000;  // and jump far enough ahead that the followers start over
+  link_moment = now + LINK_LEAD * (F_CPU / 8000UL);
+  link_moment_msec = link_sync_msec + LINK_LEAD;
+  tune_link_lead();
+}
+
+void tune_link_lead (void) {
+  // Send the sync tick and the moments of the score that are due, and set link_deadline
+  // for what is next. Call this from the interrupt routine, or with interrupts off.
+  unsigned long now = tune_wait_now();
+  unsigned long lead = LINK_LEAD * (F_CPU / 8000UL);
+  if ((long)(now - link_sync) >= -WAIT_MARGIN) {
+    // The tick says what time it is, so only send it on time and when the line is idle.
+    // Otherwise try again in a msec.
+    if ((long)(now - link_sync) <= WAIT_MARGIN && (long)(link_line_free - now) <= 0) {
+      tune_link_send(LINK_SYNC);
+      tune_link_send(link_sync_msec >> 8);
+      tune_link_send(link_sync_msec & 0xff);
+      link_sync += LINK_SYNC_INTERVAL * (F_CPU / 8000UL);
+      link_sync_msec += LINK_SYNC_INTERVAL;
+    }
+    else while ((long)(now - link_sync) >= -WAIT_MARGIN) {
+        link_sync += F_CPU / 8000UL;
+        ++link_sync_msec;
+      }
   }
-  while (notdone);
-  doing_delay = false;
+  while (link_cursor && (long)(link_moment - lead - now) <= WAIT_MARGIN)
+    tune_link_moment();
+  link_deadline = link_sync;
+  if (link_cursor && (long)(link_moment - lead - link_sync) < 0) link_deadline = link_moment - lead;
+}
+
+void tune_link_moment (void) {
+  // Send the commands for the followers' voices at the next moment of the score,
+  // if there are any, and move on to the moment after it.
+  byte cmd, chan, note, i;
+  boolean sent = false;
+  unsigned duration;
+  while (1) {
+    cmd = pgm_read_byte(link_cursor++);
+    if (cmd < 0x80) { /* wait: the moment is over unless it's a wait of 0 */
+      duration = ((unsigned)cmd << 8) | (pgm_read_byte(link_cursor++));
+      link_moment += (unsigned long) duration * (F_CPU / 8000UL);
+      link_moment_msec += duration;
+      if (duration) return;
+      continue;
+    }
+    chan = cmd & 0x0f;
+    switch (cmd & 0xf0) {
+      case CMD_PLAYNOTE:
+        note = pgm_read_byte(link_cursor++);
+        if (link_volume) ++link_cursor;
+        if (chan < _tune_num_chans) continue;  // one of ours
+        break;
+      case CMD_STOPNOTE:
+        if (chan < _tune_num_chans) continue;
+        break;
+      case CMD_INSTRUMENT:
+        ++link_cursor;
+        continue;
+      case CMD_RESTART:
+        link_cursor = link_start;
+        continue;
+      case CMD_STOP:
+        cmd = CMD_STOP;
+        break;
+      default:
+        continue;
+    }
+    if (!sent) { /* say when these are due */
+      tune_link_send(LINK_MOMENT);
+      tune_link_send(link_moment_msec >> 8);
+      tune_link_send(link_moment_msec & 0xff);
+      sent = true;
+    }
+    tune_link_send(cmd);
+    if ((cmd & 0xf0) == CMD_PLAYNOTE) tune_link_send(note);
+    if (cmd == CMD_STOP) {
+      if (tune_queue_count > link_ahead) { /* the player will go on to the next queued score */
+        i = tune_queue_first + link_ahead;
+        if (i >= TUNE_QUEUE_SIZE) i -= TUNE_QUEUE_SIZE;
+        link_start = link_cursor = tune_queue_entries[i].start;
+#if TUNE_HEADER
+        link_volume = tune_queue_entries[i].volume;
+#else
+        link_volume = ASSUME_VOLUME;
+#endif
+        ++link_ahead;
+        continue;
+      }
+      link_cursor = 0;  // that's all
+      return;
+    }
+  }
+}
+
+void tune_link_send (byte b) {
+  // Send a byte, and keep track of when the line will be idle again.
+  unsigned long now = tune_wait_now();
+  if ((long)(link_line_free - now) < 0) link_line_free = now;
+  link_line_free += link_byte_ticks;
+  link_stream->write(b);
 }
 
+void tune_link_stop (void) {
+  // Tell the followers to stop now. Call this with interrupts off, while the alarm is on.
+  long until_sync = link_sync - tune_wait_now();
+  uint16_t msec = link_sync_msec - (int16_t)(until_sync / (long)(F_CPU / 8000UL));
+  tune_link_send(LINK_MOMENT);
+  tune_link_send(msec >> 8);
+  tune_link_send(msec & 0xff);
+  tune_link_send(CMD_STOP);
+  link_cursor = 0;
+}
+
+void Playtune::tune_link_poll (void) {
+  // A follower takes in the bytes that have arrived. The sooner this is called after a
+  // sync tick arrives, the better our clock will match the leader's.
+  if (link_mode != LINK_FOLLOWING) return;
+  while (link_stream->available() > 0)
+    tune_link_receive(link_stream->read());
+}
+
+void tune_link_receive (byte b) {
+  if (link_rx_need) {  // more of the message
+    link_rx_value = (link_rx_value << 8) | b;
+    if (--link_rx_need) return;
+  }
+  else {  // a new message
+    link_rx_cmd = b;
+    link_rx_value = 0;
+    link_rx_need = (b == LINK_SYNC || b == LINK_MOMENT) ? 2 : (b & 0xf0) == CMD_PLAYNOTE ? 1 : 0;
+    if (link_rx_need) return;
+  }
+  noInterrupts();
+  if (link_rx_cmd == LINK_SYNC) tune_link_sync(link_rx_value);
+  else if (link_rx_cmd == LINK_MOMENT) link_rx_msec = link_rx_value;
+  else tune_link_event(link_rx_cmd, (byte) link_rx_value);
+  interrupts();
+}
+
+void tune_link_sync (uint16_t msec) {
+  // The leader's clock read "msec" when it started sending the sync tick that just
+  // arrived, three bytes ago. Move our idea of when that was halfway to when it really
+  // was, and adjust the speed of our clock by a quarter of the error over the interval.
+  // At the second tick after starting over, measure the speed instead.
+  unsigned long sent = tune_wait_now() - 3 * link_byte_ticks;
+  unsigned long expected = tune_link_time(msec);
+  long error = sent - expected;
+  long span = (long)(int16_t)(msec - link_anchor_msec) * (F_CPU / 8000UL);
+  long relock = LINK_RELOCK * (F_CPU / 8000UL);
+  if (!link_locked || error > relock || error < -relock || span < 0x10000L) {
+    link_anchor = sent;  // we're lost: start over from here, but keep the speed correction
+    link_locked = 1;
+  }
+  else if (link_locked == 1) {
+    link_anchor = sent;
+    link_rate += (error << 8) / (span >> 8);
+    link_locked = 2;
+  }
+  else {
+    link_anchor = expected + error / 2;
+    link_rate += ((error << 8) / (span >> 8)) / 4;
+  }
+  if (link_rate > LINK_MAX_RATE) link_rate = LINK_MAX_RATE;
+  if (link_rate < -LINK_MAX_RATE) link_rate = -LINK_MAX_RATE;
+  link_anchor_msec = msec;
+}
+
+unsigned long tune_link_time (uint16_t msec) {
+  // Our timer 1 time for a time on the leader's clock not too far from the last sync tick
+  long ticks = (long)(int16_t)(msec - link_anchor_msec) * (F_CPU / 8000UL);
+  return link_anchor + ticks + (((ticks >> 8) * link_rate) >> 8);
+}
+
+void tune_link_event (byte cmd, byte note) {
+  // A command for the moment being received. Keep it if it's a stop or for one of our
+  // channels, and drop anything else, which can only be a garbled byte.
+  // Call this with interrupts off.
+  byte chan = (cmd & 0x0f) - link_first_voice, i;
+  if (!link_locked) return;  // we can't tell when it's due
+  if (cmd == CMD_STOP || cmd == CMD_RESTART) cmd = CMD_STOP;
+  else {
+    if ((cmd & 0xf0) != CMD_PLAYNOTE && (cmd & 0xf0) != CMD_STOPNOTE) return;
+    if ((cmd & 0x0f) < link_first_voice || chan >= _tune_num_chans) return;
+    cmd = (cmd & 0xf0) | chan;
+  }
+  if (link_events_count >= LINK_EVENTS) return;  // no room: the leader is too far ahead
+  i = link_events_first + link_events_count;
+  if (i >= LINK_EVENTS) i -= LINK_EVENTS;
+  link_events[i].msec = link_rx_msec;
+  link_events[i].cmd = cmd;
+  link_events[i].note = note;
+  if (++link_events_count == 1) { // it's next
+    Playtune::tune_playing = true;
+    tune_link_play();
+  }
+}
+
+void tune_link_play (void) {
+  // A follower does the commands that are due, and sets the alarm for the next one.
+  // This is called instead of tune_stepscore(), so call it from the interrupt routine,
+  // or with interrupts off.
+  byte cmd, chan;
+  struct link_event_t *event;
+  while (link_events_count) {
+    event = &link_events[link_events_first];
+    score_deadline = tune_link_time(event->msec);
+    if ((long)(score_deadline - tune_wait_now()) > WAIT_MARGIN) break;
+    cmd = event->cmd;
+    if ((cmd & 0xf0) == CMD_PLAYNOTE) tune_playnote(cmd & 0x0f, event->note);
+    else if ((cmd & 0xf0) == CMD_STOPNOTE) tune_stopnote(cmd & 0x0f);
+    else if (cmd == CMD_STOP)
+      for (chan = 0; chan < _tune_num_chans; ++chan)
+        tune_stopnote(chan);
+    if (++link_events_first >= LINK_EVENTS) link_events_first = 0;
+    if (--link_events_count == 0 && cmd == CMD_STOP) Playtune::tune_playing = false;
+  }
+  tune_wait_arm();
+}
+#endif
+
 //-----------------------------------------------
 // Stop all channels
 //-----------------------------------------------
@@ -790,34 +1969,38 @@ void Playtune::tune_stopchans(void) {
   byte chan;
   byte timer_num;
 
+  tune_stopscore();  // forget the score, the queue, and the followers, so tune_playing is false
+#if TUNE_LINK
+  link_mode = LINK_NONE;  // a follower would turn the alarm back on
+#endif
   for (chan = 0; chan < _tune_num_chans; ++chan) {
     timer_num = pgm_read_byte(tune_pin_to_timer_PGM + chan);
     switch (timer_num) {
 
-#if !defined(__AVR_ATmega8__)
+#if TIMER_USED(0)
       case 0:
         TIMSK0 &= ~(1 << OCIE0A);  // disable all timer interrupts
         break;
 #endif
       case 1:
-        TIMSK1 &= ~(1 << OCIE1A);
+        TIMSK1 &= ~((1 << OCIE1A) | (1 << OCIE1B));
         break;
-#if !defined(__AVR_ATmega32U4__)
+#if TIMER_USED(2)
       case 2:
         TIMSK2 &= ~(1 << OCIE2A);
         break;
 #endif
-#if defined(__AVR_ATmega1280__)||defined(__AVR_ATmega2560__)||defined(__AVR_ATmega32U4__)
+#if TIMER_USED(3)
       case 3:
         TIMSK3 &= ~(1 << OCIE3A);
         break;
 #endif
-#if defined(__AVR_ATmega1280__)||defined(__AVR_ATmega2560__)||defined(__AVR_ATmega32U4__)
+#if TIMER_USED(4)
       case 4:
         TIMSK4 &= ~(1 << OCIE4A);
         break;
 #endif
-#if defined(__AVR_ATmega1280__)||defined(__AVR_ATmega2560__)
+#if TIMER_USED(5)
       case 5:
         TIMSK5 &= ~(1 << OCIE5A);
         break;
@@ -825,77 +2008,156 @@ void Playtune::tune_stopchans(void) {
     }
     digitalWrite(_tune_pins[chan], 0);
   }
+#if TESLA_COIL
+  if (_tune_num_chans) {  // stop the pulses too
+#if defined(__AVR_ATmega32U4__)
+    TIMSK0 &= ~(1 << OCIE0A);
+#else
+    TIMSK2 &= ~(1 << OCIE2A);
+#endif
+    TESLA_PULSE_STOP();
+    digitalWrite(TESLA_PIN, 0);
+  }
+#endif
   _tune_num_chans = 0;
 }
 
+#if TESLA_COIL
+//-----------------------------------------------
+//  Tesla coil pulses
+//-----------------------------------------------
+
+void teslacoil_init (void) {
+  // Set up the pin and the pulse timer when the first channel is initialized.
+  byte chan;
+  unsigned long now;
+
+  pinMode(TESLA_PIN, OUTPUT);
+  digitalWrite(TESLA_PIN, 0);
+  tesla_pin_port = portOutputRegister(digitalPinToPort(TESLA_PIN));
+  tesla_pin_mask = digitalPinToBitMask(TESLA_PIN);
+#if defined(__AVR_ATmega32U4__)
+  TCCR0A = 1 << WGM01;
+  TCCR0B = 0;
+  OCR0A = TESLA_TICKS(TESLA_PULSE_USEC);
+  TIMSK0 |= 1 << OCIE0A;
+#elif defined(__AVR_ATmega8__)
+  TCCR2 = 1 << WGM21;
+  OCR2 = TESLA_TICKS(TESLA_PULSE_USEC);
+  TIMSK |= 1 << OCIE2;
+#else
+  TCCR2A = 1 << WGM21;
+  TCCR2B = 0;
+  OCR2A = TESLA_TICKS(TESLA_PULSE_USEC);
+  TIMSK2 |= 1 << OCIE2A;
+#endif
+  now = tune_wait_now();
+  tesla_pulse_start = now - TESLA_TICKS(TESLA_MERGE_USEC);
+  for (chan = 0; chan < AVAILABLE_TIMERS; ++chan) tesla_voice_next[chan] = now;
+  tesla_duty_next = now;
+}
+
+byte teslacoil_checknote (byte note) {
+  // Move notes that are too high for one tone generator's pulse rate down by octaves.
+  if (note > 127) note = 127;
+  while (note >= 12 && pgm_read_word(tune_frequencies2_PGM + note) > 2000000UL / TESLA_VOICE_USEC)
+    note -= 12;
+  return note;
+}
+
+void teslacoil_rising_edge (byte chan) {
+  // Called from the interrupt routine of tone generator "chan" at each rising edge
+  unsigned long now = tune_wait_now();
+  unsigned long ahead;
+
+  if (now - tesla_pulse_start < TESLA_TICKS(TESLA_MERGE_USEC))
+    return;  // merge it into the pulse that just started
+  if (tesla_voice_next[chan] - now - 1 < TESLA_TICKS(TESLA_VOICE_USEC))
+    return;  // this tone generator pulsed too recently
+  ahead = tesla_duty_next - now;
+  if (ahead > TESLA_BURST * TESLA_SPACING) ahead = 0;  // it's in the past
+  else if (ahead > (TESLA_BURST - 1) * TESLA_SPACING)
+    return;  // all the tone generators together are over the duty limit
+  *tesla_pin_port |= tesla_pin_mask;  // start the pulse
+  TESLA_PULSE_START();
+  tesla_pulse_start = now;
+  tesla_voice_next[chan] = now + TESLA_TICKS(TESLA_VOICE_USEC);
+  tesla_duty_next = now + ahead + TESLA_SPACING;
+}
+#endif
+
 //-----------------------------------------------
 //  Timer Interrupt Service Routines
 //-----------------------------------------------
 
-#if !defined(__AVR_ATmega8__) && !TESLA_COIL
+#if TIMER_USED(0)
 ISR(TIMER0_COMPA_vect) {  // **** TIMER 0
-  *timer0_pin_port ^= timer0_pin_mask; // toggle the pin
+  TIMER_PORT(0) ^= TIMER_MASK(0); // toggle the pin
+}
+#endif
+
+#if TESLA_COIL
+ISR(TESLA_PULSE_VECT) {  // **** TIMER 2, or 0 on the ATmega32U4: the end of a Tesla coil pulse
+  *tesla_pin_port &= ~tesla_pin_mask;
+  TESLA_PULSE_STOP();
 }
 #endif
 
 ISR(TIMER1_COMPA_vect) {  // **** TIMER 1
-  // We keep this running always and use it to time score waits, whether or not it is playing a note.
-  if (wait_timer_playing) { // toggle the pin if we're sounding a note
-    *timer1_pin_port ^= timer1_pin_mask;
+  uint16_t next = OCR1A + timer1_half_period;
+  TIMER_PORT(1) ^= TIMER_MASK(1);
 #if TESLA_COIL
-    if (*timer1_pin_port & timer1_pin_mask) teslacoil_rising_edge (2);  // do a tesla coil pulse
-#endif
-  }
-  if (Playtune::tune_playing && wait_toggle_count && --wait_toggle_count == 0) {
-    // end of a score wait, so execute more score commands
-    wait_timer_old_frequency2 = wait_timer_frequency2;  // save this timer's frequency
-    tune_stepscore ();  // execute commands
-    // If this timer's frequency has changed and we're using it for a tune_delay(),
-    // recompute the number of toggles to wait for
-    if (doing_delay && wait_timer_old_frequency2 != wait_timer_frequency2) {
-      if (delay_toggle_count >= 0x20000UL && wait_timer_frequency2 >= 0x4000U) {
-        // Need scaling to avoid 32-bit overflow...
-        delay_toggle_count = ( (delay_toggle_count + 4 >> 3) * (wait_timer_frequency2 + 2 >> 2) / wait_timer_old_frequency2 ) << 5;
-      }
-      else {
-        delay_toggle_count = delay_toggle_count * wait_timer_frequency2 / wait_timer_old_frequency2;
-      }
-    }
-  }
-  if (doing_delay && delay_toggle_count) --delay_toggle_count;	// countdown for tune_delay()
+  if (TIMER_PORT(1) & TIMER_MASK(1)) teslacoil_rising_edge (TIMER1_CHAN);  // do a tesla coil pulse
+#endif
+  // Unlike the other timers, this one doesn't restart at the compare value, so if we
+  // were held off for more than half a period, catch up rather than wait for a whole turn.
+  if ((int16_t)(next - TCNT1) <= 0) next = TCNT1 + timer1_half_period;
+  OCR1A = next;
 }
 
-#if !defined(__AVR_ATmega32U4__)
-#if !TESLA_COIL
+ISR(TIMER1_COMPB_vect) {  // **** TIMER 1 alarm, for score waits and tune_delay()
+#if TUNE_LINK
+  if (link_mode == LINK_LEADING && Playtune::tune_playing && (long)(link_deadline - tune_wait_now()) <= WAIT_MARGIN)
+    tune_link_lead();  // send the followers what they need now
+#endif
+#if TUNE_ARPEGGIO
+  if (Playtune::tune_playing && ARP_SHARING && (long)(arp_deadline - tune_wait_now()) <= WAIT_MARGIN)
+    tune_arpeggio_step();  // the next note's turn on timer 1
+#endif
+  if (Playtune::tune_playing && (long)(score_deadline - tune_wait_now()) <= WAIT_MARGIN)
+    tune_stepscore();  // the wait is over, so execute more score commands and set the alarm again
+  else tune_wait_arm();
+}
+
+#if TIMER_USED(2)
 ISR(TIMER2_COMPA_vect) {  // **** TIMER 2
-  *timer2_pin_port ^= timer2_pin_mask;  // toggle the pin
+  TIMER_PORT(2) ^= TIMER_MASK(2);  // toggle the pin
 }
 #endif
-#endif
 
-#if defined(__AVR_ATmega1280__)||defined(__AVR_ATmega2560__)||defined(__AVR_ATmega32U4__)
+#if TIMER_USED(3)
 ISR(TIMER3_COMPA_vect) {  // **** TIMER 3
-  *timer3_pin_port ^= timer3_pin_mask;  // toggle the pin
+  TIMER_PORT(3) ^= TIMER_MASK(3);  // toggle the pin
 #if TESLA_COIL
-  if (*timer3_pin_port & timer3_pin_mask) teslacoil_rising_edge (3);  // do a tesla coil pulse
+  if (TIMER_PORT(3) & TIMER_MASK(3)) teslacoil_rising_edge (TIMER3_CHAN);  // do a tesla coil pulse
 #endif
 }
 #endif
 
-#if defined(__AVR_ATmega1280__)||defined(__AVR_ATmega2560__)||defined(__AVR_ATmega32U4__)
+#if TIMER_USED(4)
 ISR(TIMER4_COMPA_vect) {  // **** TIMER 4
-  *timer4_pin_port ^= timer4_pin_mask;  // toggle the pin
+  TIMER_PORT(4) ^= TIMER_MASK(4);  // toggle the pin
 #if TESLA_COIL
-  if (*timer4_pin_port & timer4_pin_mask) teslacoil_rising_edge (4);  // do a tesla coil pulse
+  if (TIMER_PORT(4) & TIMER_MASK(4)) teslacoil_rising_edge (TIMER4_CHAN);  // do a tesla coil pulse
 #endif
 }
 #endif
 
-#if defined(__AVR_ATmega1280__)||defined(__AVR_ATmega2560__)
+#if TIMER_USED(5)
 ISR(TIMER5_COMPA_vect) {  // **** TIMER 5
-  *timer5_pin_port ^= timer5_pin_mask;  // toggle the pin
+  TIMER_PORT(5) ^= TIMER_MASK(5);  // toggle the pin
 #if TESLA_COIL
-  if (*timer5_pin_port & timer5_pin_mask) teslacoil_rising_edge (5);  // do a tesla coil pulse
+  if (TIMER_PORT(5) & TIMER_MASK(5)) teslacoil_rising_edge (TIMER5_CHAN);  // do a tesla coil pulse
 #endif
 }
 #endif
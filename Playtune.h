@@ -19,6 +19,14 @@
 *     - added support for ATmega32U4
 *  10 July 2016, Nick Shvelidze
 *     - Fixed include file names for Arduino 1.6 on Linux.
+*  18 October 2026
+*     - Add tune_idle() and tune_sleepcycles() for low-power playing.
+*     - Add tune_queue(), tune_queued(), and tune_catalog_t for gapless playlists.
+*     - Time score waits and delays with a timer 1 compare B alarm, not note toggles.
+*     - Add tune_lead(), tune_follow(), and tune_link_poll() to play a score on several boards.
+*     - Add TUNE_CHANS, TUNE_DELAY, TUNE_HEADER, and fixed pins to build only what is used.
+*     - Add TUNE_VERIFY and tune_verify() to check scores once and play them without checks.
+*     - Add TUNE_ARPEGGIO to play the notes that have no tone generator in turns on timer 1.
 */
 
 #ifndef Playtune_h
@@ -26,6 +34,48 @@
 
 #include <Arduino.h>
 
+/* What to build. Turning off what a sketch doesn't use saves flash and RAM, and
+  extras/size_report shows how much. Change them by editing this file. Playtune.cpp
+  is compiled apart from the sketch, so defining them in the sketch before including
+  Playtune.h saves nothing, and leaves the sketch and the library disagreeing about
+  what is in the Playtune class. */
+#ifndef TUNE_QUEUE_SIZE
+#define TUNE_QUEUE_SIZE 4	// how many scores can wait to be played
+#endif
+#ifndef TUNE_LINK
+#define TUNE_LINK 0		// play on several boards? Off unless needed: it takes about 180 bytes of RAM
+#endif
+#ifndef TUNE_CHANS
+#define TUNE_CHANS 6		// the most tone generators to use; the other timers are left alone
+#endif
+#ifndef TUNE_DELAY
+#define TUNE_DELAY 1		// include tune_delay()?
+#endif
+#ifndef TUNE_HEADER
+#define TUNE_HEADER 1		// look for the optional file header? If not, all scores are alike
+#endif
+#ifndef TUNE_VERIFY
+#define TUNE_VERIFY 1		// check scores before playing them, and refuse the bad ones?
+#endif
+#ifndef TUNE_ARPEGGIO
+#define TUNE_ARPEGGIO 0		// Hz: notes without a tone generator take turns on timer 1 this often, or 0
+#endif
+
+/* The output pins can also be fixed here, as the port letter and bit of each tone
+  generator in order. For example, pin 10 of a Nano or Uno is port B, bit 2:
+    #define TUNE_PORT0 B
+    #define TUNE_BIT0 2
+  The interrupt routines then toggle the pins with constant port instructions instead
+  of through a pointer, and the pointers aren't needed. Fix all the pins or none, and
+  give the same pins to tune_initchan(). */
+
+struct tune_catalog_t {		// a PROGMEM catalog entry for a score
+ const byte *score;		// the score bytestream
+ byte hdr_length;		// the length of its file header, or 0
+ byte f1;			// flag byte 1 of the header (0x80: volume present)
+ unsigned long duration;	// how long it plays, in milliseconds
+};
+
 class Playtune
 {
 public:
@@ -33,8 +83,23 @@ public:
  void tune_playscore (const byte *score);	// start playing a polyphonic score
  volatile static boolean tune_playing;	// is the score still playing?
  void tune_stopscore (void);			// stop playing the score
+ boolean tune_queue (const byte *score);	// play a score after the current one
+ boolean tune_queue (const tune_catalog_t *entry);	// the same, from a PROGMEM catalog
+ byte tune_queued (void);			// how many scores are waiting to play
+#if TUNE_VERIFY
+ boolean tune_verify (const byte *score);	// is the score good? (and remember it)
+#endif
+#if TUNE_DELAY
  void tune_delay (unsigned msec);		// delay in milliseconds
+#endif
+ void tune_idle (void);				// sleep until the next interrupt
+ unsigned long tune_sleepcycles (boolean reset);	// processor cycles spent sleeping
  void tune_stopchans (void);			// stop all timers
+#if TUNE_LINK
+ void tune_lead (Stream *link, unsigned long baud);	// send the voices we can't play to followers
+ void tune_follow (Stream *link, unsigned long baud, byte first_voice);	// play voices sent by a leader
+ void tune_link_poll (void);			// followers: take in what the leader sent
+#endif
 };
 
 #endif
@@ -989,11 +989,11 @@ void setup() {
 void loop () {
   
   pt.tune_playscore (score1); /* start playing */
-  while (pt.tune_playing) ;   /* wait here until playing stops */
+  while (pt.tune_playing) pt.tune_idle(); /* sleep here until playing stops */
   pt.tune_delay(1000);        /* wait a second */
   
   pt.tune_playscore (score2); /* start playing */
-  while (pt.tune_playing) ;   /* wait here until playing stops */
+  while (pt.tune_playing) pt.tune_idle(); /* sleep here until playing stops */
   pt.tune_delay(1000);        /* wait a second */
 }
 
@@ -197,7 +197,7 @@ void setup() {
 void loop() {
 
   pt.tune_playscore (score); /* start playing */
-  while (pt.tune_playing) ; /* wait here until playing stops */
+  while (pt.tune_playing) pt.tune_idle(); /* sleep here until playing stops */
   pt.tune_delay(1000); /* wait a second */
   
 }
\ No newline at end of file
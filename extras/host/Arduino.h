@@ -0,0 +1,270 @@
+/**************************************************************************
+*
+*  Host stand-in for the Arduino core, used to compile Playtune.cpp on a
+*  desktop computer for the simulation tools in this directory.
+*
+*  The timer registers are objects that tell the virtual microcontroller
+*  in playtune_sim.cpp when they are written (or read, for the counters),
+*  the output ports are plain bytes, and the interrupt vectors become
+*  ordinary functions that the simulator calls when a timer event is due.
+*
+*  Select the processor the same way avr-gcc does, for example with
+*  -D__AVR_ATmega2560__. The default is the ATmega328P (Nano, Uno).
+*
+*  (C) Copyright 2026, the Playtune contributors. MIT License, as in Playtune.cpp
+*
+**************************************************************************/
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if !defined(__AVR_ATmega8__) && !defined(__AVR_ATmega32U4__) \
+ && !defined(__AVR_ATmega1280__) && !defined(__AVR_ATmega2560__) \
+ && !defined(__AVR_ATmega168__) && !defined(__AVR_ATmega328P__)
+#define __AVR_ATmega328P__
+#endif
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+//  program memory is ordinary memory here
+
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define memcpy_P(dst, src, len) memcpy((dst), (const void *)(src), (len))
+
+//  the processor clock can be chosen at run time
+
+extern unsigned long sim_f_cpu;
+#define F_CPU sim_f_cpu
+
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define bitWrite(value, bit, bitvalue) ((bitvalue) ? bitSet(value, bit) : bitClear(value, bit))
+
+//  digital pins: pin p is bit (p & 7) of port (p >> 3)
+
+#define SIM_NUM_PORTS 16
+extern volatile uint8_t sim_ports[SIM_NUM_PORTS];
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#define digitalPinToPort(pin) ((pin) >> 3)
+#define digitalPinToBitMask(pin) (1 << ((pin) & 7))
+#define portOutputRegister(port) (&sim_ports[port])
+inline void pinMode(uint8_t pin, uint8_t mode) {
+  (void) pin; (void) mode;
+}
+void digitalWrite(uint8_t pin, uint8_t val);
+
+//  The ports by name, for Playtune's fixed pins: port A is pins 0-7, B is 8-15, and so on
+#define PORTA sim_ports[0]
+#define PORTB sim_ports[1]
+#define PORTC sim_ports[2]
+#define PORTD sim_ports[3]
+#define PORTE sim_ports[4]
+#define PORTF sim_ports[5]
+#define PORTG sim_ports[6]
+#define PORTH sim_ports[7]
+#define PORTJ sim_ports[8]
+#define PORTK sim_ports[9]
+#define PORTL sim_ports[10]
+
+//  Interrupts are simulated, so the foreground code can only be
+//  interrupted when it enables interrupts. The virtual clock only runs
+//  while the foreground code sleeps (see avr/sleep.h) or when the tools
+//  run it.
+
+void sim_cli(void);
+void sim_sei(void);
+#define noInterrupts() sim_cli()
+#define interrupts() sim_sei()
+
+//  debugging output goes to stderr
+
+#define DEC 10
+#define HEX 16
+class sim_serial {
+public:
+  void begin(unsigned long baud) {
+    (void) baud;
+  }
+  void print(const char *s);
+  void print(char c);
+  void print(long n, int base = DEC);
+  void print(unsigned long n, int base = DEC);
+  void print(int n, int base = DEC) {
+    print((long) n, base);
+  }
+  void print(unsigned n, int base = DEC) {
+    print((unsigned long) n, base);
+  }
+  void print(unsigned char n, int base = DEC) {
+    print((unsigned long) n, base);
+  }
+  template <typename T> void println(T x) {
+    print(x); print('\n');
+  }
+  template <typename T> void println(T x, int base) {
+    print(x, base); print('\n');
+  }
+};
+extern sim_serial Serial;
+
+//  the core's base class for serial ports and other byte streams
+
+class Stream {
+public:
+  virtual int available(void) = 0;
+  virtual int read(void) = 0;
+  virtual int peek(void) = 0;
+  virtual size_t write(uint8_t b) = 0;
+  virtual ~Stream() { }
+};
+
+//  timer registers
+
+enum sim_regkind {
+  SIM_TCCRA, SIM_TCCRB, SIM_TCCRD, SIM_TCNT, SIM_OCRA, SIM_OCRB, SIM_OCRC, SIM_TIMSK, SIM_TIFR
+};
+#define SIM_ALL_TIMERS 0xff  // for the ATmega8's shared TIMSK and TIFR
+
+class sim_reg {
+public:
+  sim_reg(uint8_t timer_num, uint8_t regkind, unsigned initial = 0)
+    : timer(timer_num), kind(regkind), value(initial) { }
+  operator unsigned() const {
+    return read();
+  }
+  template <typename T> sim_reg &operator=(T x) {
+    write((unsigned long) x); return *this;
+  }
+  sim_reg &operator=(const sim_reg &r) {
+    write(r.read()); return *this;
+  }
+  template <typename T> sim_reg &operator|=(T x) {
+    write(read() | (unsigned long) x); return *this;
+  }
+  template <typename T> sim_reg &operator&=(T x) {
+    write(read() & (unsigned long) x); return *this;
+  }
+  template <typename T> sim_reg &operator^=(T x) {
+    write(read() ^ (unsigned long) x); return *this;
+  }
+  template <typename T> sim_reg &operator+=(T x) {
+    write(read() + (unsigned long) x); return *this;
+  }
+  unsigned read(void) const;
+  void write(unsigned long x);
+  uint8_t timer, kind;
+  unsigned value;
+};
+
+#define SIM_VECTORS(n) \
+  void sim_vect_timer##n##_compa(void) __attribute__((weak)); \
+  void sim_vect_timer##n##_compb(void) __attribute__((weak)); \
+  void sim_vect_timer##n##_ovf(void) __attribute__((weak));
+SIM_VECTORS(0) SIM_VECTORS(1) SIM_VECTORS(2) SIM_VECTORS(3) SIM_VECTORS(4) SIM_VECTORS(5)
+#define ISR(vector) void vector(void)
+
+#if defined(__AVR_ATmega8__)
+
+extern sim_reg TCCR1A, TCCR1B, TCNT1, OCR1A, OCR1B;
+extern sim_reg TCCR2, TCNT2, OCR2, TIMSK, TIFR;
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define WGM12 3
+#define CS20 0
+#define CS21 1
+#define CS22 2
+#define WGM21 3
+#define COM20 4
+#define COM21 5
+#define TOIE1 2
+#define OCIE1B 3
+#define OCIE1A 4
+#define OCIE2 7
+#define TOV1 2
+#define OCF1B 3
+#define OCF1A 4
+#define TIMER1_COMPA_vect sim_vect_timer1_compa
+#define TIMER1_COMPB_vect sim_vect_timer1_compb
+#define TIMER1_OVF_vect sim_vect_timer1_ovf
+#define TIMER2_COMP_vect sim_vect_timer2_compa
+
+#else // all the others have the same timer 0 and timer 1
+
+extern sim_reg TCCR0A, TCCR0B, TCNT0, OCR0A, OCR0B, TIMSK0;
+extern sim_reg TCCR1A, TCCR1B, TCNT1, OCR1A, OCR1B, TIMSK1, TIFR1;
+#define WGM01 1
+#define CS00 0
+#define CS01 1
+#define CS02 2
+#define TOIE0 0
+#define OCIE0A 1
+#define OCIE0B 2
+#define WGM12 3
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define TOIE1 0
+#define OCIE1A 1
+#define OCIE1B 2
+#define TOV1 0
+#define OCF1A 1
+#define OCF1B 2
+#define TIMER0_COMPA_vect sim_vect_timer0_compa
+#define TIMER1_COMPA_vect sim_vect_timer1_compa
+#define TIMER1_COMPB_vect sim_vect_timer1_compb
+#define TIMER1_OVF_vect sim_vect_timer1_ovf
+
+#if !defined(__AVR_ATmega32U4__)
+extern sim_reg TCCR2A, TCCR2B, TCNT2, OCR2A, OCR2B, TIMSK2;
+#define WGM21 1
+#define CS20 0
+#define CS21 1
+#define CS22 2
+#define OCIE2A 1
+#define TIMER2_COMPA_vect sim_vect_timer2_compa
+#endif
+
+#if defined(__AVR_ATmega1280__)||defined(__AVR_ATmega2560__)||defined(__AVR_ATmega32U4__)
+extern sim_reg TCCR3A, TCCR3B, TCNT3, OCR3A, OCR3B, TIMSK3;
+#define WGM32 3
+#define CS30 0
+#define OCIE3A 1
+#define TIMER3_COMPA_vect sim_vect_timer3_compa
+#endif
+
+#if defined(__AVR_ATmega1280__)||defined(__AVR_ATmega2560__)
+extern sim_reg TCCR4A, TCCR4B, TCNT4, OCR4A, OCR4B, TIMSK4;
+extern sim_reg TCCR5A, TCCR5B, TCNT5, OCR5A, OCR5B, TIMSK5;
+#define WGM42 3
+#define CS40 0
+#define OCIE4A 1
+#define WGM52 3
+#define CS50 0
+#define OCIE5A 1
+#define TIMER4_COMPA_vect sim_vect_timer4_compa
+#define TIMER5_COMPA_vect sim_vect_timer5_compa
+#endif
+
+#if defined(__AVR_ATmega32U4__)  // the 10-bit high-speed timer 4
+extern sim_reg TCCR4A, TCCR4B, TCCR4D, TCNT4, OCR4A, OCR4B, OCR4C, TIMSK4;
+#define CS40 0
+#define WGM40 0
+#define OCIE4B 5
+#define OCIE4A 6
+#define TIMER4_COMPA_vect sim_vect_timer4_compa
+#endif
+
+#endif // !ATmega8
+#endif
@@ -0,0 +1,25 @@
+/**************************************************************************
+*
+*  Host stand-in for the avr-libc sleep functions.
+*
+*  Sleeping lets the virtual clock run to the next interrupt, and adds the
+*  time to sim_sleep_cycles. Every sleep mode is treated as idle sleep,
+*  where the timers keep running.
+*
+*  (C) Copyright 2026, the Playtune contributors. MIT License, as in Playtune.cpp
+*
+**************************************************************************/
+
+#ifndef avr_sleep_h
+#define avr_sleep_h
+
+#define SLEEP_MODE_IDLE 0
+#define SLEEP_MODE_PWR_DOWN 2
+
+void sim_sleep(void);
+#define set_sleep_mode(mode) ((void)(mode))
+#define sleep_enable()
+#define sleep_disable()
+#define sleep_cpu() sim_sleep()
+
+#endif
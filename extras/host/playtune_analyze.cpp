@@ -0,0 +1,298 @@
+/**************************************************************************
+*
+*  playtune_analyze: will this score play well on that processor?
+*
+*  This reads Playtune score bytestreams, including the optional file
+*  header and any volume and instrument bytes, and reports for each
+*  processor Playtune supports, and for each processor clock:
+*
+*   - whether the score uses more tone generators than the processor has,
+*     and how many notes are lost because of that
+*   - the notes that are too low for their timers to play
+*   - the peak interrupt rate, and how much of the processor the
+*     interrupt routines take at that point
+*   - the worst-case time spent in tune_stepscore() at one moment of the
+*     score, during which all other interrupts are held off
+*
+*  Scores that lose notes, that need more than all of the processor, or
+*  whose score steps take longer than half a period of the highest note
+*  that is playing (so its square wave will glitch) are flagged.
+*
+*  Usage: playtune_analyze [-mNAME] [-fN] [-tN] [-v] [-cFILE] file ...
+*     -mNAME  only this processor (ATmega8, ATmega328P, ATmega32U4, ATmega2560);
+*             can be repeated
+*     -fN     only this processor clock, in Mhz; can be repeated (default 8 and 16)
+*     -tN     also show a timeline with a line for every N seconds
+*     -v      assume volume bytes are present in scores without a header
+*     -cFILE  also write a C file with a PROGMEM catalog of the scores, in
+*             order, for Playtune's tune_queue(): the score arrays, their
+*             header lengths and flags, and their durations
+*
+*  The exit status is 1 if any score is flagged.
+*
+*  Build it with:
+*     g++ -O2 -o playtune_analyze playtune_analyze.cpp playtune_model.cpp playtune_score.cpp
+*
+*  (C) Copyright 2026, the Playtune contributors. MIT License, as in Playtune.cpp
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "playtune_model.h"
+
+#define MAX_CHANS 16
+
+static std::vector<const playtune_mcu *> mcus;
+static std::vector<unsigned long> clocks;
+static double timeline_seconds = 0;
+static bool assume_volume = false;
+static const char *catalog_file = NULL;
+static std::vector<std::string> catalog;  // its entries
+
+struct window_stats {  // the worst of everything in a stretch of time
+  int notes;
+  unsigned long notes_lost, notes_low, glitches;
+  double peak_rate, peak_load;
+  unsigned long worst_step;
+  unsigned long peak_rate_time, worst_step_time;
+  void clear() {
+    memset(this, 0, sizeof(*this));
+  }
+  void add(const window_stats &w) {
+    if (w.notes > notes) notes = w.notes;
+    notes_lost += w.notes_lost;
+    notes_low += w.notes_low;
+    glitches += w.glitches;
+    if (w.peak_rate > peak_rate) {
+      peak_rate = w.peak_rate;
+      peak_rate_time = w.peak_rate_time;
+    }
+    if (w.peak_load > peak_load) peak_load = w.peak_load;
+    if (w.worst_step > worst_step) {
+      worst_step = w.worst_step;
+      worst_step_time = w.worst_step_time;
+    }
+  }
+};
+
+static void show_heading(void) {
+  printf("%-18s %5s %6s %7s %11s %9s %22s %6s\n",
+         "", "notes", "lost", "too low", "peak int/s", "load", "worst step", "glitch");
+}
+
+static void show_stats(const char *label, const window_stats &w, unsigned long f_cpu) {
+  printf("%-18s %5d %6lu %7lu %11.0f %8.1f%% %7lu cyc %6.0f us %6lu\n",
+         label, w.notes, w.notes_lost, w.notes_low, w.peak_rate, w.peak_load * 100,
+         w.worst_step, w.worst_step * 1e6 / f_cpu, w.glitches);
+}
+
+static bool analyze(const playtune_decoded &score, const playtune_mcu *mcu, unsigned long f_cpu) {
+  bool sounding[MAX_CHANS] = { false };
+  int notes[MAX_CHANS];
+  unsigned long step = CYCLES_ISR_ENTRY;
+  window_stats total, window;
+  total.clear();
+  window.clear();
+  unsigned long window_start = 0, window_ms = (unsigned long)(timeline_seconds * 1000);
+  char label[40];
+
+  if (window_ms) {
+    printf("\n%s at %lu Mhz\n", mcu->name, f_cpu / 1000000);
+    show_heading();
+  }
+  for (size_t i = 0; i < score.cmds.size(); ++i) {
+    const playtune_cmd &cmd = score.cmds[i];
+    if (window_ms && cmd.time >= window_start + window_ms) {
+      sprintf(label, "%9.1f s", window_start / 1000.0);
+      show_stats(label, window, f_cpu);
+      total.add(window);
+      window.clear();
+      window_start = cmd.time / window_ms * window_ms;
+    }
+    step += command_cycles(mcu, cmd, f_cpu);
+    if (cmd.opcode == CMD_PLAYNOTE && cmd.chan < MAX_CHANS) {
+      if (cmd.chan >= mcu->num_timers) ++window.notes_lost;
+      else if (!note_playable(mcu, cmd.chan, cmd.note, f_cpu)) ++window.notes_low;
+      else {
+        sounding[cmd.chan] = true;
+        notes[cmd.chan] = cmd.note;
+      }
+    }
+    else if (cmd.opcode == CMD_STOPNOTE && cmd.chan < MAX_CHANS) sounding[cmd.chan] = false;
+    if (cmd.opcode != CMD_WAIT && cmd.opcode != CMD_STOP && cmd.opcode != CMD_RESTART) continue;
+
+    // The end of the commands for this moment: look at what is playing until the next one.
+    int playing = 0;
+    unsigned fastest = 0;
+    double rate = alarm_rate(f_cpu);  // timer 1's alarm for the score waits
+    double load = rate * alarm_isr_cycles() / f_cpu;
+    for (int chan = 0; chan < mcu->num_timers; ++chan)
+      if (sounding[chan]) {
+        unsigned frequency2 = note_frequency2(notes[chan]);
+        ++playing;
+        rate += frequency2;
+        load += (double) frequency2 * toggle_isr_cycles(mcu->timers[chan]) / f_cpu;
+        if (frequency2 > fastest) fastest = frequency2;
+      }
+    if (playing > window.notes) window.notes = playing;
+    if (rate > window.peak_rate) {
+      window.peak_rate = rate;
+      window.peak_rate_time = cmd.time;
+    }
+    if (load > window.peak_load) window.peak_load = load;
+    if (step > window.worst_step) {
+      window.worst_step = step;
+      window.worst_step_time = cmd.time;
+    }
+    if (fastest && step > f_cpu / fastest) ++window.glitches;  // longer than a half period
+    step = CYCLES_ISR_ENTRY;
+  }
+  if (window_ms) {
+    sprintf(label, "%9.1f s", window_start / 1000.0);
+    show_stats(label, window, f_cpu);
+  }
+  total.add(window);
+
+  if (window_ms) strcpy(label, "    whole score");
+  else sprintf(label, "%-10s %2lu Mhz", mcu->name, f_cpu / 1000000);
+  show_stats(label, total, f_cpu);
+  bool flagged = false;
+  if (total.notes_lost) {
+    printf("%18s loses %lu notes: the score uses more than %d tone generators\n",
+           "", total.notes_lost, mcu->num_timers);
+    flagged = true;
+  }
+  if (total.notes_low) {
+    printf("%18s loses %lu notes that are too low: below note %d on the 8-bit timers, or %d on timer 1\n",
+           "", total.notes_low, lowest_8bit_note(f_cpu), lowest_timer1_note(f_cpu));
+    flagged = true;
+  }
+  if (total.peak_load >= 1.0) {
+    printf("%18s OVERRUNS the processor at %.3f seconds\n", "", total.peak_rate_time / 1000.0);
+    flagged = true;
+  }
+  if (total.glitches) {
+    printf("%18s %lu score steps are longer than half a period of the highest note; worst at %.3f seconds\n",
+           "", total.glitches, total.worst_step_time / 1000.0);
+    flagged = true;
+  }
+  return !flagged;
+}
+
+static bool write_catalog(void) {
+  FILE *f = fopen(catalog_file, "w");
+  if (!f) {
+    fprintf(stderr, "can't create %s\n", catalog_file);
+    return false;
+  }
+  fprintf(f, "// Playtune catalog of %u scores, generated by playtune_analyze\n", (unsigned) catalog.size());
+  fprintf(f, "// (The score arrays must be declared before this.)\n");
+  fprintf(f, "const tune_catalog_t PROGMEM tune_catalog [] = {\n");
+  for (size_t i = 0; i < catalog.size(); ++i) fprintf(f, "%s\n", catalog[i].c_str());
+  fprintf(f, "};\n");
+  bool ok = !ferror(f);
+  if (fclose(f) != 0 || !ok) {
+    fprintf(stderr, "error writing %s\n", catalog_file);
+    return false;
+  }
+  return true;
+}
+
+static bool analyze_score(const playtune_score &score) {
+  playtune_decoded decoded;
+  bool ok = decode_score(score, decoded, assume_volume);
+  int max_chan = -1, max_notes = 0, percussion = 0;
+  bool sounding[MAX_CHANS] = { false };
+  unsigned long notes = 0, instruments = 0;
+  for (size_t i = 0; i < decoded.cmds.size(); ++i) {
+    const playtune_cmd &cmd = decoded.cmds[i];
+    if (cmd.opcode == CMD_PLAYNOTE) {
+      ++notes;
+      if (cmd.note > 127) ++percussion;
+      if (cmd.chan > max_chan) max_chan = cmd.chan;
+      sounding[cmd.chan] = true;
+    }
+    else if (cmd.opcode == CMD_STOPNOTE) sounding[cmd.chan] = false;
+    else if (cmd.opcode == CMD_INSTRUMENT) ++instruments;
+    int playing = 0;
+    for (int chan = 0; chan < MAX_CHANS; ++chan) playing += sounding[chan];
+    if (playing > max_notes && (i + 1 == decoded.cmds.size() || decoded.cmds[i + 1].time != cmd.time))
+      max_notes = playing;
+  }
+  printf("\n%s: %u bytes, %u commands, %lu notes, %.1f seconds\n",
+         score_basename(score).c_str(), (unsigned) score.data.size(), (unsigned) decoded.cmds.size(),
+         notes, decoded.duration / 1000.0);
+  if (decoded.header_present)
+    printf("  header: %d bytes, flags %02X %02X, %d tone generators%s%s%s\n",
+           decoded.hdr_length, decoded.f1, decoded.f2, decoded.num_tgens,
+           decoded.f1 & HDR_F1_VOLUME_PRESENT ? ", volume" : "",
+           decoded.f1 & HDR_F1_INSTRUMENTS_PRESENT ? ", instruments" : "",
+           decoded.f1 & HDR_F1_PERCUSSION_PRESENT ? ", percussion" : "");
+  else printf("  no header%s\n", decoded.volume_present ? ", volume bytes assumed" : "");
+  printf("  uses %d tone generators, with at most %d notes at once; %lu instrument changes\n",
+         max_chan + 1, max_notes, instruments);
+  if (percussion) printf("  %d percussion notes will be played as note 127\n", percussion);
+  if (!ok) printf("  ERROR: %s\n", decoded.error.c_str());
+  else {
+    char entry[200];
+    snprintf(entry, sizeof(entry), "  { %s, %d, 0x%02X, %luUL },  // %s, %lu:%04.1f",
+             score.name.c_str(), decoded.header_present ? decoded.hdr_length : 0,
+             decoded.header_present ? decoded.f1 : decoded.volume_present ? HDR_F1_VOLUME_PRESENT : 0,
+             decoded.duration, score_basename(score).c_str(),
+             decoded.duration / 60000, (decoded.duration % 60000) / 1000.0);
+    catalog.push_back(entry);
+  }
+
+  if (!timeline_seconds) {
+    printf("\n");
+    show_heading();
+  }
+  for (size_t m = 0; m < mcus.size(); ++m)
+    for (size_t c = 0; c < clocks.size(); ++c)
+      if (!analyze(decoded, mcus[m], clocks[c])) ok = false;
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  int argn;
+  for (argn = 1; argn < argc && argv[argn][0] == '-'; ++argn) {
+    const char *arg = argv[argn] + 2;
+    switch (argv[argn][1]) {
+      case 'm':
+        if (!find_mcu(arg)) {
+          fprintf(stderr, "unknown processor %s\n", arg);
+          return 1;
+        }
+        mcus.push_back(find_mcu(arg));
+        break;
+      case 'f': clocks.push_back((unsigned long)(atof(arg) * 1000000)); break;
+      case 't': timeline_seconds = atof(arg); break;
+      case 'v': assume_volume = true; break;
+      case 'c': catalog_file = arg; break;
+      default:
+        fprintf(stderr, "unknown option %s\n", argv[argn]);
+        return 1;
+    }
+  }
+  if (argn >= argc) {
+    fprintf(stderr, "usage: playtune_analyze [-mNAME] [-fN] [-tN] [-v] [-cFILE] file ...\n");
+    return 1;
+  }
+  if (mcus.empty())
+    for (int i = 0; i < playtune_num_mcus; ++i) mcus.push_back(&playtune_mcus[i]);
+  if (clocks.empty()) {
+    clocks.push_back(8000000UL);
+    clocks.push_back(16000000UL);
+  }
+  std::vector<playtune_score> scores;
+  for (; argn < argc; ++argn)
+    if (!load_scores(argv[argn], scores)) return 1;
+  int flagged = 0;
+  for (size_t i = 0; i < scores.size(); ++i)
+    if (!analyze_score(scores[i])) ++flagged;
+  if (flagged) printf("\n%d of %u scores were flagged\n", flagged, (unsigned) scores.size());
+  if (catalog_file && !write_catalog()) return 1;
+  return flagged ? 1 : 0;
+}
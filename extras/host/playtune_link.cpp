@@ -0,0 +1,396 @@
+/**************************************************************************
+*
+*  playtune_link: play a score on several simulated boards at once
+*
+*  This tests Playtune's leader and follower modes, tune_lead() and
+*  tune_follow(), without any hardware. Each board is a separate process
+*  with its own simulated processor, and the serial link between them is
+*  a pipe: the leader's process writes each byte it sends, with the time
+*  it was sent, and this program delivers it to every follower at the
+*  time the last bit would arrive at the link's speed, after the bytes
+*  ahead of it on the line. The followers' crystals can be set to run a
+*  little fast or slow, to see how well they keep in step.
+*
+*  Every board records when each of its voices starts a note, and the
+*  times are compared with the score: the onset skew of a note is how
+*  much later or earlier it starts than where the score puts it, taking
+*  the leader's own notes as the reference. For every moment of the score
+*  where notes start on more than one board, the spread is the time
+*  between the first and the last of them.
+*
+*  Usage: playtune_link [-nN] [-cN] [-bN] [-pN] [-fN] [-sN] [-tN] file ...
+*     -nN   number of followers (default 1)
+*     -cN   use only N tone generators on each board (default: all the processor has)
+*     -bN   speed of the serial link in baud (default 115200)
+*     -pN   clock error of the followers in parts per million: the first is
+*           N fast, the second N slow, the third 2N fast, and so on (default 100)
+*     -fN   processor clock in Mhz (default 16)
+*     -sN   stop after N seconds if the score hasn't ended (default 600)
+*     -tN   the most skew allowed, in microseconds (default 1000)
+*
+*  The exit status is 1 if any note was skewed by more than allowed, or
+*  was missed by a follower.
+*
+*  Build it for the processor of the boards, for example:
+*     g++ -O2 -I. -D__AVR_ATmega2560__ -DTUNE_LINK=1 -o playtune_link
+*         playtune_link.cpp playtune_sim.cpp playtune_score.cpp
+*
+*  (C) Copyright 2026, the Playtune contributors. MIT License, as in Playtune.cpp
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "playtune_sim.h"
+#include "playtune_score.h"
+
+#if !TUNE_LINK
+#error "build playtune_link with -DTUNE_LINK=1"
+#endif
+
+#define MAX_CHANS 16
+#define MAX_BOARDS 16
+
+static int num_followers = 1;
+static int max_chans = MAX_CHANS;
+static unsigned long baud = 115200;
+static double ppm = 100;
+static double max_seconds = 600;
+static double tolerance = 1000;
+
+static Playtune pt;
+
+struct wire_byte {   // a byte on the link, and when it was sent or arrives, in seconds
+  double time;
+  unsigned char b;
+};
+
+struct onset {       // a note starting on a board
+  int voice;
+  double time;       // seconds
+};
+
+static double board_error(int board) {
+  // the clock error of a board as a fraction: the leader's is exact
+  if (board == 0) return 0;
+  return (board & 1 ? 1 : -1) * ((board + 1) / 2) * ppm * 1e-6;
+}
+
+//-----------------------------------------------
+// One board, in its own process
+//-----------------------------------------------
+
+static double board_hz;  // how fast this board's processor really runs
+
+static double board_seconds(void) {
+  return (double) sim_now() / board_hz;
+}
+
+class wire_stream : public Stream {
+  // The board's serial port. The pipe delivers the bytes in the order they arrive,
+  // each with its arrival time, and a byte can be read once that time has come.
+public:
+  wire_stream(int in_fd, int out_fd) : in(in_fd), out(out_fd), have_next(false), ended(in_fd < 0) { }
+  int available(void) {
+    return arrival() <= sim_now() ? 1 : 0;
+  }
+  int read(void) {
+    if (!available()) return -1;
+    have_next = false;
+    return next.b;
+  }
+  int peek(void) {
+    return available() ? next.b : -1;
+  }
+  size_t write(uint8_t b) {
+    wire_byte w = { board_seconds(), b };
+    if (out >= 0 && ::write(out, &w, sizeof(w)) != (ssize_t) sizeof(w)) {
+      perror("link write");
+      _exit(2);
+    }
+    return 1;
+  }
+  sim_time_t arrival(void) {  // when the next byte can be read, or SIM_NEVER
+    if (!have_next && !ended) {
+      ssize_t n = ::read(in, &next, sizeof(next));
+      if (n == (ssize_t) sizeof(next)) have_next = true;
+      else ended = true;
+    }
+    return have_next ? (sim_time_t) ceil(next.time * board_hz) : SIM_NEVER;
+  }
+  bool done(void) {
+    return !have_next && ended;
+  }
+private:
+  int in, out;
+  wire_byte next;
+  bool have_next, ended;
+};
+
+static int run_board(int board, const playtune_score &score, int in_fd, int out_fd, FILE *report) {
+  board_hz = sim_f_cpu * (1 + board_error(board));
+  int nchans = sim_num_chans(), first_voice = board * nchans;
+  bool sounding[MAX_CHANS] = { false };
+  unsigned long restarts[MAX_CHANS];
+  for (int chan = 0; chan < nchans; ++chan) restarts[chan] = sim_timer_restarts(sim_chan_timer(chan));
+  wire_stream wire(in_fd, out_fd);
+  sim_time_t stop_time = (sim_time_t)(max_seconds * board_hz);
+  if (board == 0) {
+    pt.tune_lead(&wire, baud);
+    pt.tune_playscore(&score.data[0]);
+  }
+  else pt.tune_follow(&wire, baud, first_voice);
+  while (1) {
+    if (board) pt.tune_link_poll();
+    for (int chan = 0; chan < nchans; ++chan) {
+      bool now_sounding = sim_chan_sounding(chan);
+      unsigned long now_restarts = sim_timer_restarts(sim_chan_timer(chan));
+      if (now_sounding && (!sounding[chan] || now_restarts != restarts[chan])) {
+        onset o = { first_voice + chan, board_seconds() };
+        fwrite(&o, sizeof(o), 1, report);
+      }
+      sounding[chan] = now_sounding;
+      restarts[chan] = now_restarts;
+    }
+    sim_time_t next = sim_next_event();
+    if (board) {
+      if (wire.done() && !Playtune::tune_playing) break;
+      if (wire.arrival() < next) next = wire.arrival();
+    }
+    else if (!Playtune::tune_playing) break;
+    if (next > stop_time) break;
+    sim_run_until(next);
+  }
+  pt.tune_stopscore();
+  if (out_fd >= 0) close(out_fd);
+  fclose(report);
+  return 0;
+}
+
+//-----------------------------------------------
+// The link, and the measurements
+//-----------------------------------------------
+
+struct skew_stats {
+  int onsets, missed;
+  double sum, max;
+};
+
+static void match_onsets(const std::vector<double> &expected, std::vector<double> &played,
+                         double offset, std::vector<int> &which) {
+  // Match each note played on a voice to the nearest note the score starts on it.
+  size_t j = 0;
+  which.clear();
+  for (size_t i = 0; i < played.size(); ++i) {
+    double t = played[i] - offset;
+    while (j + 1 < expected.size() && fabs(expected[j + 1] - t) <= fabs(expected[j] - t)) ++j;
+    if (j < expected.size()) which.push_back((int) j++);
+    else which.push_back(-1);
+  }
+}
+
+static int link_score(const playtune_score &score) {
+  playtune_decoded decoded;
+  if (!decode_score(score, decoded)) {
+    fprintf(stderr, "%s: %s\n", score_basename(score).c_str(), decoded.error.c_str());
+    return 1;
+  }
+  int boards = num_followers + 1;
+  int leader_pipe[2], follower_pipes[MAX_BOARDS][2];
+  FILE *reports[MAX_BOARDS];
+  pid_t pids[MAX_BOARDS];
+  if (pipe(leader_pipe) < 0) {
+    perror("pipe");
+    return 1;
+  }
+  for (int board = 0; board < boards; ++board) {
+    reports[board] = tmpfile();
+    if (!reports[board] || (board && pipe(follower_pipes[board]) < 0)) {
+      perror("can't make the link");
+      return 1;
+    }
+  }
+  fflush(stdout);
+  for (int board = 0; board < boards; ++board) {
+    pids[board] = fork();
+    if (pids[board] < 0) {
+      perror("fork");
+      return 1;
+    }
+    if (pids[board] == 0) {  // keep only this board's ends of the pipes
+      int in = -1, out = -1;
+      if (board == 0) out = leader_pipe[1];
+      else {
+        in = follower_pipes[board][0];
+        close(leader_pipe[1]);
+      }
+      close(leader_pipe[0]);
+      for (int other = 1; other < boards; ++other) {
+        close(follower_pipes[other][1]);
+        if (other != board) close(follower_pipes[other][0]);
+      }
+      _exit(run_board(board, score, in, out, reports[board]));
+    }
+  }
+  close(leader_pipe[1]);
+  for (int board = 1; board < boards; ++board) close(follower_pipes[board][0]);
+
+  // Carry the bytes from the leader to all the followers, one after another on the line.
+  double byte_time = 10.0 / baud, line_free = 0;
+  unsigned long bytes = 0;
+  wire_byte w;
+  while (read(leader_pipe[0], &w, sizeof(w)) == (ssize_t) sizeof(w)) {
+    line_free = (w.time > line_free ? w.time : line_free) + byte_time;
+    w.time = line_free;
+    for (int board = 1; board < boards; ++board)
+      if (write(follower_pipes[board][1], &w, sizeof(w)) != (ssize_t) sizeof(w)) {
+        perror("link write");
+        return 1;
+      }
+    ++bytes;
+  }
+  close(leader_pipe[0]);
+  for (int board = 1; board < boards; ++board) close(follower_pipes[board][1]);
+  int failures = 0, status;
+  for (int board = 0; board < boards; ++board)
+    if (waitpid(pids[board], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      fprintf(stderr, "board %d failed\n", board);
+      ++failures;
+    }
+  if (failures) return 1;
+
+  // When the score starts each voice's notes, in seconds
+  std::vector<std::vector<double> > expected(MAX_CHANS), played(MAX_CHANS);
+  int voices = 0;
+  for (size_t i = 0; i < decoded.cmds.size(); ++i)
+    if (decoded.cmds[i].opcode == CMD_PLAYNOTE && decoded.cmds[i].chan < MAX_CHANS) {
+      expected[decoded.cmds[i].chan].push_back(decoded.cmds[i].time / 1000.0);
+      if (decoded.cmds[i].chan >= voices) voices = decoded.cmds[i].chan + 1;
+    }
+  std::vector<int> board_of(MAX_CHANS, -1);
+  for (int board = 0; board < boards; ++board) {
+    onset o;
+    rewind(reports[board]);
+    while (fread(&o, sizeof(o), 1, reports[board]) == 1)
+      if (o.voice < MAX_CHANS) {
+        played[o.voice].push_back(o.time);
+        board_of[o.voice] = board;
+      }
+    fclose(reports[board]);
+  }
+
+  // The leader's notes say when the score started.
+  double offset = HUGE_VAL;
+  for (int voice = 0; voice < MAX_CHANS; ++voice)
+    if (board_of[voice] == 0 && !played[voice].empty() && !expected[voice].empty()
+        && played[voice][0] - expected[voice][0] < offset)
+      offset = played[voice][0] - expected[voice][0];
+  if (offset == HUGE_VAL) {
+    fprintf(stderr, "%s: the leader played nothing\n", score_basename(score).c_str());
+    return 1;
+  }
+
+  skew_stats stats[MAX_BOARDS];
+  memset(stats, 0, sizeof(stats));
+  std::vector<double> moment_first, moment_last;
+  std::vector<int> moment_board;
+  std::vector<double> moments;
+  for (int voice = 0; voice < voices; ++voice) {
+    int board = board_of[voice];
+    if (board < 0) continue;
+    std::vector<int> which;
+    match_onsets(expected[voice], played[voice], offset, which);
+    for (size_t i = 0; i < played[voice].size(); ++i) {
+      if (which[i] < 0) continue;
+      double at = expected[voice][which[i]];
+      double skew = (played[voice][i] - offset - at) * 1e6;
+      ++stats[board].onsets;
+      stats[board].sum += skew;
+      if (fabs(skew) > stats[board].max) stats[board].max = fabs(skew);
+      // collect the onsets at each moment, to find the spread between boards
+      size_t m;
+      for (m = 0; m < moments.size() && moments[m] != at; ++m);
+      if (m == moments.size()) {
+        moments.push_back(at);
+        moment_first.push_back(played[voice][i]);
+        moment_last.push_back(played[voice][i]);
+        moment_board.push_back(board);
+      }
+      else {
+        if (played[voice][i] < moment_first[m]) moment_first[m] = played[voice][i];
+        if (played[voice][i] > moment_last[m]) moment_last[m] = played[voice][i];
+        if (moment_board[m] != board) moment_board[m] = -1;  // more than one board
+      }
+    }
+    stats[board].missed += (int) expected[voice].size() - (int) which.size();
+  }
+  int shared = 0;
+  double spread_sum = 0, spread_max = 0;
+  for (size_t m = 0; m < moments.size(); ++m)
+    if (moment_board[m] < 0) {
+      double spread = (moment_last[m] - moment_first[m]) * 1e6;
+      ++shared;
+      spread_sum += spread;
+      if (spread > spread_max) spread_max = spread;
+    }
+
+  int nchans = sim_num_chans();
+  printf("%s: %d boards of %d voices for %d voices, %lu baud, %.1f seconds\n",
+         score_basename(score).c_str(), boards, nchans, voices, baud, decoded.duration / 1000.0);
+  printf("   link: %lu bytes, %.0f bytes/s, %.1f%% of the line\n", bytes,
+         bytes / (decoded.duration / 1000.0), 100.0 * bytes * byte_time / (decoded.duration / 1000.0));
+  bool bad = false;
+  for (int board = 0; board < boards; ++board) {
+    skew_stats &s = stats[board];
+    char name[40];
+    if (board == 0) strcpy(name, "leader");
+    else sprintf(name, "follower %d (%+.0f ppm)", board, board_error(board) * 1e6);
+    printf("   %-22s %6d notes, skew mean %+7.1f max %7.1f usec", name, s.onsets,
+           s.onsets ? s.sum / s.onsets : 0, s.max);
+    if (s.missed) printf(", %d missed", s.missed);
+    printf("\n");
+    if (s.max > tolerance || (board && s.missed > 0)) bad = true;
+  }
+  printf("   %d moments start notes on more than one board, spread mean %.1f max %.1f usec\n",
+         shared, shared ? spread_sum / shared : 0, spread_max);
+  if (voices > boards * nchans)
+    printf("   voices %d and up aren't played by any board\n", boards * nchans);
+  return bad ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+  int argn;
+  for (argn = 1; argn < argc && argv[argn][0] == '-'; ++argn) {
+    const char *arg = argv[argn] + 2;
+    switch (argv[argn][1]) {
+      case 'n': num_followers = atoi(arg); break;
+      case 'c': max_chans = atoi(arg); break;
+      case 'b': baud = strtoul(arg, NULL, 10); break;
+      case 'p': ppm = atof(arg); break;
+      case 'f': sim_f_cpu = (unsigned long)(atof(arg) * 1000000); break;
+      case 's': max_seconds = atof(arg); break;
+      case 't': tolerance = atof(arg); break;
+      default:
+        fprintf(stderr, "unknown option %s\n", argv[argn]);
+        return 1;
+    }
+  }
+  if (argn >= argc || sim_f_cpu == 0 || baud == 0 || num_followers < 0 || num_followers >= MAX_BOARDS) {
+    fprintf(stderr, "usage: playtune_link [-nN] [-cN] [-bN] [-pN] [-fN] [-sN] [-tN] file ...\n");
+    return 1;
+  }
+  std::vector<playtune_score> scores;
+  for (; argn < argc; ++argn)
+    if (!sim_load_scores(argv[argn], scores)) return 1;
+
+  for (int chan = 0; chan < max_chans && chan < MAX_CHANS; ++chan)
+    pt.tune_initchan(2 + chan);   // (extra calls are ignored) for all the boards
+  int failures = 0;
+  for (size_t i = 0; i < scores.size(); ++i)
+    failures += link_score(scores[i]);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,121 @@
+/**************************************************************************
+*
+*  What Playtune does with each processor, and what it costs.
+*  See playtune_model.h for the interface.
+*
+*  (C) Copyright 2026, the Playtune contributors. MIT License, as in Playtune.cpp
+*
+**************************************************************************/
+
+#include <string.h>
+#include <strings.h>
+#include "playtune_model.h"
+
+// These must match the tune_pin_to_timer_PGM tables in Playtune.cpp.
+const playtune_mcu playtune_mcus[] = {
+  { "ATmega8", 2, { 1, 2 }, false },
+  { "ATmega328P", 3, { 1, 2, 0 }, false },
+  { "ATmega32U4", 4, { 1, 0, 3, 4 }, true },
+  { "ATmega2560", 6, { 1, 2, 3, 4, 5, 0 }, false }
+};
+const int playtune_num_mcus = sizeof(playtune_mcus) / sizeof(playtune_mcus[0]);
+
+const playtune_mcu *find_mcu(const char *name) {
+  for (int i = 0; i < playtune_num_mcus; ++i)
+    if (strcasecmp(playtune_mcus[i].name, name) == 0) return &playtune_mcus[i];
+  return NULL;
+}
+
+const unsigned short playtune_frequencies2[128] = {
+  16, 17, 18, 19, 21, 22, 23, 24, 26, 28, 29, 31, 33, 35, 37, 39, 41,
+  44, 46, 49, 52, 55, 58, 62, 65, 69, 73, 78, 82, 87, 92, 98, 104, 110,
+  117, 123, 131, 139, 147, 156, 165, 175, 185, 196, 208, 220, 233,
+  247, 262, 277, 294, 311, 330, 349, 370, 392, 415, 440, 466, 494,
+  523, 554, 587, 622, 659, 698, 740, 784, 831, 880, 932, 988, 1047,
+  1109, 1175, 1245, 1319, 1397, 1480, 1568, 1661, 1760, 1865, 1976,
+  2093, 2217, 2349, 2489, 2637, 2794, 2960, 3136, 3322, 3520, 3729,
+  3951, 4186, 4435, 4699, 4978, 5274, 5588, 5920, 6272, 6645, 7040,
+  7459, 7902, 8372, 8870, 9397, 9956, 10548, 11175, 11840, 12544,
+  13290, 14080, 14917, 15804, 16744, 17740, 18795, 19912, 21096,
+  22351, 23680, 25088
+};
+
+bool timer_is_8bit(const playtune_mcu *mcu, int timer) {
+  return timer == 0 || timer == 2 || (timer == 4 && mcu->timer4_is_10bit);
+}
+
+int lowest_8bit_note(unsigned long f_cpu) {
+  return f_cpu <= 8000000UL ? 12 : 24;
+}
+
+static unsigned long timer1_half_period(unsigned long f_cpu, int note) {  // as in tune_playnote()
+  unsigned long frequency2 = playtune_frequencies2[note];
+  return (f_cpu / 8 + frequency2 / 2) / frequency2;
+}
+
+int lowest_timer1_note(unsigned long f_cpu) {
+  int note = 0;
+  while (note < 127 && timer1_half_period(f_cpu, note) > 0xffff) ++note;
+  return note;
+}
+
+bool note_playable(const playtune_mcu *mcu, int chan, int note, unsigned long f_cpu) {
+  if (chan >= mcu->num_timers) return false;
+  if (note > 127) note = 127;
+  if (mcu->timers[chan] == 1) return timer1_half_period(f_cpu, note) <= 0xffff;
+  return !timer_is_8bit(mcu, mcu->timers[chan]) || note >= lowest_8bit_note(f_cpu);
+}
+
+unsigned note_frequency2(int note) {
+  return playtune_frequencies2[note > 127 ? 127 : note];
+}
+
+unsigned long playnote_cycles(const playtune_mcu *mcu, int chan, int note, unsigned long f_cpu) {
+  // Mostly the divisions that tune_playnote() does to find the prescaler and compare value.
+  unsigned long cycles = 60;
+  if (chan >= mcu->num_timers) return 20;
+  if (note > 127) note = 127;
+  int timer = mcu->timers[chan];
+  unsigned long frequency2 = playtune_frequencies2[note];
+  int divisions = 1;
+  if (timer_is_8bit(mcu, timer)) {
+    if (note < lowest_8bit_note(f_cpu)) return cycles;
+    // the same scan through the prescalers that tune_playnote() does
+    static const unsigned short scan2[] = { 8, 32, 64, 128, 256, 1024 };
+    static const unsigned short scan[] = { 8, 64, 256, 1024 };
+    const unsigned short *steps = timer == 2 ? scan2 : scan;
+    int nsteps = timer == 2 ? 6 : 4;
+    unsigned long ocr = f_cpu / frequency2 - 1;
+    for (int i = 0; i < nsteps && ocr > 255; ++i) {
+      ocr = f_cpu / frequency2 / steps[i] - 1;
+      ++divisions;
+    }
+  }
+  else if (timer != 1 && f_cpu / frequency2 - 1 > 0xffff) ++divisions;  // timer 1 has one prescaler
+  return cycles + divisions * CYCLES_DIVIDE32;
+}
+
+unsigned long command_cycles(const playtune_mcu *mcu, const playtune_cmd &cmd, unsigned long f_cpu) {
+  // the time tune_stepscore() takes for one command, including reading and decoding it
+  switch (cmd.opcode) {
+    case CMD_WAIT: return 30 + CYCLES_MULTIPLY32 + CYCLES_WAIT_ALARM;  // computing the deadline
+    case CMD_PLAYNOTE: return 25 + playnote_cycles(mcu, cmd.chan, cmd.note, f_cpu);
+    case CMD_STOPNOTE: return 25 + 35;
+    default: return 20;
+  }
+}
+
+unsigned long toggle_isr_cycles(int timer) {
+  // timer 1 also moves its compare value ahead for the next toggle
+  return CYCLES_ISR_ENTRY + (timer == 1 ? 30 : 15);
+}
+
+double alarm_rate(unsigned long f_cpu) {
+  // Besides ending each wait, the alarm goes off at least every 0xf000 ticks of
+  // timer 1 (WAIT_MAX_ALARM in Playtune.cpp) to keep track of the time.
+  return f_cpu / 8.0 / 0xf000;
+}
+
+unsigned long alarm_isr_cycles(void) {
+  return CYCLES_ISR_ENTRY + CYCLES_WAIT_ALARM;
+}
@@ -0,0 +1,57 @@
+/**************************************************************************
+*
+*  What Playtune does with each processor, and what it costs.
+*
+*  The tools that look at scores without running them use this model of
+*  Playtune.cpp: which timers each processor gives to the tone generators,
+*  which notes each kind of timer can play, and roughly how many processor
+*  cycles the interrupt routines and the score commands take.
+*
+*  The cycle counts are estimates made by hand from the C code, from the
+*  usual cost of AVR instructions and of avr-gcc's 32-bit arithmetic
+*  routines. They have not been measured, with avr-gcc -S or on a
+*  processor or simulator, and could be off by half or more. They are
+*  meant for comparing scores and processors, and for finding the places
+*  where a score gets close to the limits, not for precise timing.
+*
+*  (C) Copyright 2026, the Playtune contributors. MIT License, as in Playtune.cpp
+*
+**************************************************************************/
+
+#ifndef playtune_model_h
+#define playtune_model_h
+
+#include "playtune_score.h"
+
+struct playtune_mcu {
+  const char *name;
+  int num_timers;
+  unsigned char timers[6];   // the order tune_initchan() assigns them, from tune_pin_to_timer_PGM
+  bool timer4_is_10bit;      // the ATmega32U4's timer 4, which is treated as 8 bits
+};
+
+extern const playtune_mcu playtune_mcus[];
+extern const int playtune_num_mcus;
+const playtune_mcu *find_mcu (const char *name);
+
+extern const unsigned short playtune_frequencies2[128];  // as in Playtune.cpp
+
+bool timer_is_8bit (const playtune_mcu *mcu, int timer);
+int lowest_8bit_note (unsigned long f_cpu);
+int lowest_timer1_note (unsigned long f_cpu);  // timer 1 never changes from clk/8
+bool note_playable (const playtune_mcu *mcu, int chan, int note, unsigned long f_cpu);
+unsigned note_frequency2 (int note);  // the interrupt rate, which is twice the note frequency
+
+// processor cycles, estimated by hand (see above)
+#define CYCLES_DIVIDE32   600   // one unsigned long division
+#define CYCLES_MULTIPLY32  60
+#define CYCLES_ISR_ENTRY   40   // interrupt entry and exit, with the registers saved
+#define CYCLES_WAIT_ALARM 100   // setting timer 1's compare B alarm for a wait
+#define CYCLES_ARPEGGIO_TURN 60 // giving the next note its turn on timer 1 (TUNE_ARPEGGIO)
+unsigned long playnote_cycles (const playtune_mcu *mcu, int chan, int note, unsigned long f_cpu);
+unsigned long command_cycles (const playtune_mcu *mcu, const playtune_cmd &cmd, unsigned long f_cpu);
+unsigned long toggle_isr_cycles (int timer);
+double alarm_rate (unsigned long f_cpu);  // the least rate of timer 1's wait alarm, per second
+unsigned long alarm_isr_cycles (void);
+
+#endif
@@ -0,0 +1,365 @@
+/**************************************************************************
+*
+*  playtune_optimize: make scores smaller and quicker to decode
+*
+*  This rewrites Playtune score bytestreams into equivalent ones that take
+*  fewer bytes and fewer commands at each moment, so tune_stepscore() has
+*  less to do in the interrupt routine:
+*
+*   - Commands that are overridden at the same moment are dropped, like a
+*     stop that is immediately followed by a new note on the same tone
+*     generator, or a restart of the note that is already playing.
+*   - Stops of tone generators that aren't playing are dropped.
+*   - Instrument changes and volume bytes, which this Playtune ignores,
+*     are removed, and the header flags are changed to match.
+*   - Back-to-back waits are combined, and moments that are no more than
+*     the tolerance apart are merged into one, as long as that doesn't
+*     start and stop a note on the same tone generator at the same time.
+*     The notes moved that way are never off by more than the tolerance.
+*   - With -m, the tone generators are rearranged so that the ones that
+*     start the most notes use the timers that are cheapest to start a note
+*     on, while keeping the lowest notes off the timers that can't play them.
+*
+*  The result is checked against the original: every tone generator must
+*  play the same notes at the same times, to within the tolerance.
+*
+*  Usage: playtune_optimize [-mNAME] [-fN] [-tN] [-k] [-v] [-b] [-oDIR] file ...
+*     -mNAME  rearrange the tone generators for this processor, and report the
+*             decoding cycles for it (default ATmega328P, not rearranged)
+*     -fN     processor clock in Mhz, for the cycle counts (default 16)
+*     -tN     how far, in msec, notes may be moved (default 1)
+*     -k      keep the instrument changes and volume bytes
+*     -v      assume volume bytes are present in scores without a header
+*     -b      write binary bytestreams (.bin) instead of C source (.c)
+*     -oDIR   directory for the output files (default: the current directory)
+*
+*  Build it with:
+*     g++ -O2 -o playtune_optimize playtune_optimize.cpp playtune_model.cpp playtune_score.cpp
+*
+*  (C) Copyright 2026, the Playtune contributors. MIT License, as in Playtune.cpp
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include "playtune_model.h"
+
+#define MAX_CHANS 16
+#define MAX_WAIT 0x7fff
+#define LOST_NOTE_CYCLES 100000000UL  // the "cost" of a note that can't be played
+
+static const playtune_mcu *mcu = NULL;
+static unsigned long f_cpu = 16000000UL;
+static unsigned long tolerance = 1;
+static bool keep_extras = false, assume_volume = false, binary = false;
+static std::string output_dir = ".";
+
+struct moment {  // the commands that happen at one time
+  unsigned long time;
+  std::vector<playtune_cmd> cmds;
+};
+
+struct score_stats {
+  unsigned long bytes, commands, max_per_moment, cycles;
+};
+
+static void make_moments(const playtune_decoded &score, std::vector<moment> &moments) {
+  for (size_t i = 0; i < score.cmds.size(); ++i) {
+    const playtune_cmd &cmd = score.cmds[i];
+    if (cmd.opcode == CMD_WAIT || cmd.opcode == CMD_STOP || cmd.opcode == CMD_RESTART) continue;
+    if (moments.empty() || moments.back().time != cmd.time) {
+      moments.push_back(moment());
+      moments.back().time = cmd.time;
+    }
+    moments.back().cmds.push_back(cmd);
+  }
+}
+
+static void simplify_moments(std::vector<moment> &moments) {
+  // Keep only the last note command for each tone generator at each moment,
+  // and drop those that don't change anything.
+  int playing[MAX_CHANS];
+  for (int chan = 0; chan < MAX_CHANS; ++chan) playing[chan] = -1;
+  for (size_t m = 0; m < moments.size(); ++m) {
+    std::vector<playtune_cmd> &cmds = moments[m].cmds, kept;
+    for (size_t i = 0; i < cmds.size(); ++i) {
+      const playtune_cmd &cmd = cmds[i];
+      if (cmd.opcode == CMD_INSTRUMENT) {
+        if (keep_extras) kept.push_back(cmd);
+        continue;
+      }
+      if (cmd.opcode != CMD_PLAYNOTE && cmd.opcode != CMD_STOPNOTE) continue; // (ignored by Playtune)
+      bool last = true;
+      for (size_t j = i + 1; j < cmds.size(); ++j)
+        if ((cmds[j].opcode == CMD_PLAYNOTE || cmds[j].opcode == CMD_STOPNOTE) && cmds[j].chan == cmd.chan)
+          last = false;
+      if (!last) continue;
+      int note = cmd.opcode == CMD_PLAYNOTE ? (cmd.note > 127 ? 127 : cmd.note) : -1;
+      if (note == playing[cmd.chan]) continue;
+      playing[cmd.chan] = note;
+      kept.push_back(cmd);
+    }
+    cmds = kept;
+  }
+  std::vector<moment> nonempty;
+  for (size_t m = 0; m < moments.size(); ++m)
+    if (!moments[m].cmds.empty()) nonempty.push_back(moments[m]);
+  moments = nonempty;
+}
+
+static void merge_moments(std::vector<moment> &moments) {
+  // Move moments earlier by up to the tolerance to combine them with the previous one.
+  std::vector<moment> merged;
+  for (size_t m = 0; m < moments.size(); ++m) {
+    if (!merged.empty() && moments[m].time - merged.back().time <= tolerance) {
+      bool conflict = false;
+      for (size_t i = 0; i < moments[m].cmds.size(); ++i)
+        for (size_t j = 0; j < merged.back().cmds.size(); ++j)
+          if (moments[m].cmds[i].chan == merged.back().cmds[j].chan) conflict = true;
+      if (!conflict) {
+        merged.back().cmds.insert(merged.back().cmds.end(), moments[m].cmds.begin(), moments[m].cmds.end());
+        continue;
+      }
+    }
+    merged.push_back(moments[m]);
+  }
+  moments = merged;
+}
+
+static void remap_channels(std::vector<moment> &moments, int map[MAX_CHANS]) {
+  // Try every arrangement of the tone generators and keep the cheapest.
+  for (int chan = 0; chan < MAX_CHANS; ++chan) map[chan] = chan;
+  if (!mcu || mcu->num_timers < 2) return;
+  int n = mcu->num_timers;
+  std::vector<int> perm;
+  for (int chan = 0; chan < n; ++chan) perm.push_back(chan);
+  unsigned long cost[MAX_CHANS][MAX_CHANS] = { { 0 } };  // voice, tone generator
+  for (size_t m = 0; m < moments.size(); ++m)
+    for (size_t i = 0; i < moments[m].cmds.size(); ++i) {
+      const playtune_cmd &cmd = moments[m].cmds[i];
+      if (cmd.opcode == CMD_PLAYNOTE && cmd.chan < n)
+        for (int chan = 0; chan < n; ++chan)
+          cost[cmd.chan][chan] += note_playable(mcu, chan, cmd.note, f_cpu)
+                                  ? playnote_cycles(mcu, chan, cmd.note, f_cpu) : LOST_NOTE_CYCLES;
+    }
+  unsigned long best = ~0UL;
+  do {
+    unsigned long total = 0;
+    for (int i = 0; i < n; ++i) total += cost[i][perm[i]];
+    if (total < best) {
+      best = total;
+      for (int i = 0; i < n; ++i) map[i] = perm[i];
+    }
+  }
+  while (std::next_permutation(perm.begin(), perm.end()));
+  for (size_t m = 0; m < moments.size(); ++m)
+    for (size_t i = 0; i < moments[m].cmds.size(); ++i)
+      moments[m].cmds[i].chan = map[moments[m].cmds[i].chan];
+}
+
+static void emit_wait(std::vector<unsigned char> &out, unsigned long wait) {
+  while (wait > 0) {
+    unsigned chunk = wait > MAX_WAIT ? MAX_WAIT : (unsigned) wait;
+    out.push_back(chunk >> 8);
+    out.push_back(chunk & 0xff);
+    wait -= chunk;
+  }
+}
+
+static void make_bytestream(const playtune_decoded &score, const std::vector<moment> &moments,
+                            bool volume, std::vector<unsigned char> &out) {
+  if (score.header_present) {
+    unsigned char f1 = score.f1;
+    if (!keep_extras) f1 &= ~(HDR_F1_VOLUME_PRESENT | HDR_F1_INSTRUMENTS_PRESENT);
+    out.push_back('P');
+    out.push_back('t');
+    out.push_back(6);
+    out.push_back(f1);
+    out.push_back(score.f2);
+    out.push_back(score.num_tgens);
+  }
+  unsigned long time = 0;
+  for (size_t m = 0; m < moments.size(); ++m) {
+    emit_wait(out, moments[m].time - time);
+    time = moments[m].time;
+    for (size_t i = 0; i < moments[m].cmds.size(); ++i) {
+      const playtune_cmd &cmd = moments[m].cmds[i];
+      out.push_back(cmd.opcode | cmd.chan);
+      if (cmd.opcode == CMD_PLAYNOTE) {
+        out.push_back(cmd.note);
+        if (volume) out.push_back(cmd.volume);
+      }
+      else if (cmd.opcode == CMD_INSTRUMENT) out.push_back(cmd.instrument);
+    }
+  }
+  emit_wait(out, score.duration - time);
+  out.push_back(score.cmds.back().opcode);  // CMD_STOP or CMD_RESTART
+}
+
+struct note_change {
+  unsigned long time;
+  int note;  // or -1 for silence
+};
+
+static void note_changes(const playtune_decoded &score, const int map[MAX_CHANS],
+                         std::vector<note_change> changes[MAX_CHANS]) {
+  // What each tone generator plays, once the changes at each moment have settled.
+  for (size_t i = 0; i < score.cmds.size(); ++i) {
+    const playtune_cmd &cmd = score.cmds[i];
+    if (cmd.opcode != CMD_PLAYNOTE && cmd.opcode != CMD_STOPNOTE) continue;
+    std::vector<note_change> &list = changes[map[cmd.chan]];
+    note_change change = { cmd.time, cmd.opcode == CMD_PLAYNOTE ? (cmd.note > 127 ? 127 : cmd.note) : -1 };
+    if (!list.empty() && list.back().time == change.time) list.pop_back();
+    int before = list.empty() ? -1 : list.back().note;
+    if (change.note != before) list.push_back(change);
+  }
+}
+
+static bool sounds_the_same(const playtune_decoded &before, const playtune_decoded &after, const int map[MAX_CHANS]) {
+  std::vector<note_change> old_changes[MAX_CHANS], new_changes[MAX_CHANS];
+  int identity[MAX_CHANS];
+  for (int chan = 0; chan < MAX_CHANS; ++chan) identity[chan] = chan;
+  note_changes(before, map, old_changes);
+  note_changes(after, identity, new_changes);
+  for (int chan = 0; chan < MAX_CHANS; ++chan) {
+    if (old_changes[chan].size() != new_changes[chan].size()) return false;
+    for (size_t i = 0; i < old_changes[chan].size(); ++i) {
+      const note_change &a = old_changes[chan][i], &b = new_changes[chan][i];
+      if (a.note != b.note || a.time > b.time + tolerance || b.time > a.time + tolerance) return false;
+    }
+  }
+  return before.duration == after.duration;
+}
+
+static score_stats measure(const playtune_score &score, const playtune_decoded &decoded) {
+  // the size, and the processor cycles tune_stepscore() spends decoding
+  const playtune_mcu *model = mcu ? mcu : find_mcu("ATmega328P");
+  score_stats stats = { (unsigned long) score.data.size(), (unsigned long) decoded.cmds.size(), 0, 0 };
+  unsigned long at_once = 0;
+  for (size_t i = 0; i < decoded.cmds.size(); ++i) {
+    stats.cycles += command_cycles(model, decoded.cmds[i], f_cpu);
+    ++at_once;
+    if (decoded.cmds[i].opcode == CMD_WAIT || i + 1 == decoded.cmds.size()) {
+      stats.cycles += CYCLES_ISR_ENTRY;
+      if (at_once > stats.max_per_moment) stats.max_per_moment = at_once;
+      at_once = 0;
+    }
+  }
+  return stats;
+}
+
+static bool write_score(const playtune_score &score, const playtune_decoded &decoded, const char *comment) {
+  std::string filename = output_dir + "/" + score_basename(score) + (binary ? ".bin" : ".c");
+  FILE *f = fopen(filename.c_str(), binary ? "wb" : "w");
+  if (!f) {
+    fprintf(stderr, "can't create %s\n", filename.c_str());
+    return false;
+  }
+  if (binary) fwrite(&score.data[0], 1, score.data.size(), f);
+  else {
+    fprintf(f, "// %s\nconst unsigned char PROGMEM %s [] = {\n", comment, score.name.c_str());
+    std::vector<bool> command(score.data.size(), false);  // show the command bytes in hex
+    for (size_t i = 0; i < decoded.cmds.size(); ++i)
+      if (decoded.cmds[i].opcode != CMD_WAIT) command[decoded.cmds[i].offset] = true;
+    int column = 0;
+    for (size_t i = 0; i < score.data.size(); ++i) {
+      column += fprintf(f, command[i] ? "0x%02X" : "%d", score.data[i]);
+      if (i + 1 < score.data.size()) column += fprintf(f, ",%s", column > 90 ? "" : " ");
+      if (column > 90) {
+        fprintf(f, "\n");
+        column = 0;
+      }
+    }
+    fprintf(f, "};\n// This score contains %u bytes.\n", (unsigned) score.data.size());
+  }
+  bool ok = !ferror(f);
+  if (fclose(f) != 0 || !ok) {
+    fprintf(stderr, "error writing %s\n", filename.c_str());
+    return false;
+  }
+  return true;
+}
+
+static bool optimize(const playtune_score &score) {
+  playtune_decoded decoded;
+  if (!decode_score(score, decoded, assume_volume)) {
+    fprintf(stderr, "%s: %s\n", score_basename(score).c_str(), decoded.error.c_str());
+    return false;
+  }
+  std::vector<moment> moments;
+  int map[MAX_CHANS];
+  make_moments(decoded, moments);
+  simplify_moments(moments);
+  merge_moments(moments);
+  remap_channels(moments, map);
+
+  playtune_score result;
+  result.file = score.file;
+  result.name = score.name;
+  bool volume = keep_extras && decoded.volume_present;
+  make_bytestream(decoded, moments, volume, result.data);
+  playtune_decoded check;
+  if (!decode_score(result, check, volume && !decoded.header_present) || !sounds_the_same(decoded, check, map)) {
+    fprintf(stderr, "%s: INTERNAL ERROR: the optimized score doesn't sound the same\n",
+            score_basename(score).c_str());
+    return false;
+  }
+
+  score_stats old_stats = measure(score, decoded), new_stats = measure(result, check);
+  char comment[200];
+  snprintf(comment, sizeof(comment), "Playtune bytestream %s optimized by playtune_optimize%s%s",
+           score_basename(score).c_str(), mcu ? " for the " : "", mcu ? mcu->name : "");
+  if (!write_score(result, check, comment)) return false;
+  printf("%s: %lu -> %lu bytes (%.1f%%), %lu -> %lu commands, at most %lu -> %lu at once,"
+         " %lu -> %lu decoding cycles (%.1f%%)\n",
+         score_basename(score).c_str(), old_stats.bytes, new_stats.bytes,
+         100.0 * ((double) new_stats.bytes - old_stats.bytes) / old_stats.bytes,
+         old_stats.commands, new_stats.commands, old_stats.max_per_moment, new_stats.max_per_moment,
+         old_stats.cycles, new_stats.cycles,
+         100.0 * ((double) new_stats.cycles - old_stats.cycles) / old_stats.cycles);
+  if (mcu) {
+    printf("   tone generators for the %s:", mcu->name);
+    for (int chan = 0; chan < mcu->num_timers; ++chan) printf(" %d->%d", chan, map[chan]);
+    printf("\n");
+  }
+  if (!decoded.header_present && decoded.volume_present && !volume)
+    printf("   the volume bytes were removed, so compile Playtune with ASSUME_VOLUME 0\n");
+  return true;
+}
+
+int main(int argc, char **argv) {
+  int argn;
+  for (argn = 1; argn < argc && argv[argn][0] == '-'; ++argn) {
+    const char *arg = argv[argn] + 2;
+    switch (argv[argn][1]) {
+      case 'm':
+        if (!(mcu = find_mcu(arg))) {
+          fprintf(stderr, "unknown processor %s\n", arg);
+          return 1;
+        }
+        break;
+      case 'f': f_cpu = (unsigned long)(atof(arg) * 1000000); break;
+      case 't': tolerance = strtoul(arg, NULL, 10); break;
+      case 'k': keep_extras = true; break;
+      case 'v': assume_volume = true; break;
+      case 'b': binary = true; break;
+      case 'o': output_dir = arg; break;
+      default:
+        fprintf(stderr, "unknown option %s\n", argv[argn]);
+        return 1;
+    }
+  }
+  if (argn >= argc || f_cpu == 0) {
+    fprintf(stderr, "usage: playtune_optimize [-mNAME] [-fN] [-tN] [-k] [-v] [-b] [-oDIR] file ...\n");
+    return 1;
+  }
+  std::vector<playtune_score> scores;
+  for (; argn < argc; ++argn)
+    if (!load_scores(argv[argn], scores)) return 1;
+  int failures = 0;
+  for (size_t i = 0; i < scores.size(); ++i)
+    if (!optimize(scores[i])) ++failures;
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,217 @@
+/**************************************************************************
+*
+*  playtune_render: render Playtune scores to WAV files, off line
+*
+*  This runs the real Playtune interrupt routines and score interpreter
+*  on a virtual processor clock, and writes a WAV file of what you would
+*  hear with each output pin connected through a resistor to a common
+*  speaker terminal: the average of the pin levels, with the DC component
+*  removed the way the speaker's coil and cone do it.
+*
+*  Each score is rendered by a separate process, so all the processors
+*  of the host are used when there are many scores. The WAV file is
+*  written in chunks as it is generated, so long scores don't need much
+*  memory.
+*
+*  Usage: playtune_render [-jN] [-rN] [-fN] [-cN] [-sN] [-pNAME] [-oDIR] file ...
+*     -jN   run at most N renderings at once (default: the number of processors)
+*     -rN   sample rate in Hz (default 44100)
+*     -fN   processor clock in Mhz (default 16)
+*     -cN   use only N tone generators (default: all the processor has)
+*     -sN   stop after N seconds if the score hasn't ended (default 600)
+*     -pNAME play all the scores, in order, as one playlist using tune_queue(),
+*           and render them to NAME.wav
+*     -oDIR directory for the output files (default: the current directory)
+*
+*  The files are sketches or C files with PROGMEM score arrays, or binary
+*  bytestream files named *.bin. The output for array "score1" in file
+*  "mega.ino" is "mega_score1.wav".
+*
+*  Build it for the processor you want to simulate, for example:
+*     g++ -O2 -I. -D__AVR_ATmega2560__ -o playtune_render
+*         playtune_render.cpp playtune_sim.cpp playtune_score.cpp
+*
+*  (C) Copyright 2026, the Playtune contributors. MIT License, as in Playtune.cpp
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "playtune_sim.h"
+#include "playtune_score.h"
+
+#define CHUNK_SAMPLES 8192
+
+static int max_jobs = 0;
+static unsigned long sample_rate = 44100;
+static int max_chans = 99;
+static double max_seconds = 600;
+static const char *playlist = NULL;
+static std::string output_dir = ".";
+
+static void put_le(unsigned char *p, unsigned long value, int bytes) {
+  while (bytes--) {
+    *p++ = value & 0xff;
+    value >>= 8;
+  }
+}
+
+static void write_wav_header(FILE *f, unsigned long data_bytes) {
+  unsigned char hdr[44];
+  memcpy(hdr, "RIFF", 4);
+  put_le(hdr + 4, 36 + data_bytes, 4);
+  memcpy(hdr + 8, "WAVEfmt ", 8);
+  put_le(hdr + 16, 16, 4);              // format chunk length
+  put_le(hdr + 20, 1, 2);               // PCM
+  put_le(hdr + 22, 1, 2);               // mono
+  put_le(hdr + 24, sample_rate, 4);
+  put_le(hdr + 28, sample_rate * 2, 4); // bytes per second
+  put_le(hdr + 32, 2, 2);               // bytes per sample
+  put_le(hdr + 34, 16, 2);              // bits per sample
+  memcpy(hdr + 36, "data", 4);
+  put_le(hdr + 40, data_bytes, 4);
+  fseek(f, 0, SEEK_SET);
+  fwrite(hdr, 1, sizeof(hdr), f);
+}
+
+static int render(const std::vector<playtune_score> &scores, size_t first, size_t count, const std::string &name) {
+  Playtune pt;
+  std::string outname = output_dir + "/" + name + ".wav";
+  FILE *out = fopen(outname.c_str(), "wb");
+  if (!out) {
+    fprintf(stderr, "can't create %s\n", outname.c_str());
+    return 1;
+  }
+  write_wav_header(out, 0);  // placeholder until we know the length
+  clock_t start = clock();
+
+  for (int chan = 0; chan < max_chans && chan < 16; ++chan)
+    pt.tune_initchan(2 + chan);   // (extra calls are ignored)
+  int nchans = sim_num_chans();
+  size_t next_score = first, end = first + count;
+  unsigned long bytes = 0;
+  for (size_t i = first; i < end; ++i) bytes += scores[i].data.size();
+  if (count == 1) pt.tune_playscore(&scores[next_score++].data[0]);
+
+  // Integrate the number of high pins over each sample period.
+  short chunk[CHUNK_SAMPLES];
+  int nsamples = 0;
+  unsigned long long samples_done = 0;
+  unsigned long long data_bytes = 0;
+  sim_time_t t = sim_now(), stop_time = (sim_time_t)(max_seconds * sim_f_cpu);
+  double dc_in = 0, dc_out = 0;
+  int high = 0;
+  while (t < stop_time) {
+    // Keep the playlist queue full, the way a jukebox sketch would.
+    while (next_score < end && pt.tune_queued() < TUNE_QUEUE_SIZE && pt.tune_queue(&scores[next_score].data[0]))
+      ++next_score;
+    if (!Playtune::tune_playing) break;
+    sim_time_t sample_end = (samples_done + 1) * sim_f_cpu / sample_rate;
+    unsigned long long high_cycles = 0;
+    sim_time_t next;
+    while ((next = sim_next_event()) <= sample_end) {
+      high_cycles += (unsigned long long) high * (next - t);
+      t = next;
+      sim_run_until(next);
+      high = 0;
+      for (int chan = 0; chan < nchans; ++chan) high += sim_pin_level(sim_chan_pin(chan));
+    }
+    high_cycles += (unsigned long long) high * (sample_end - t);
+    t = sample_end;
+    sim_run_until(t);
+
+    // y = x - x[-1] + R * y[-1] is a high-pass filter at about 10 Hz
+    double x = (double) high_cycles / ((double)(sample_end - (samples_done * sim_f_cpu / sample_rate)) * nchans);
+    dc_out = x - dc_in + 0.9986 * dc_out;
+    dc_in = x;
+    double y = dc_out * 0.9 * 32767;
+    chunk[nsamples++] = y > 32767 ? 32767 : y < -32768 ? -32768 : (short) y;
+    ++samples_done;
+    if (nsamples == CHUNK_SAMPLES) {
+      fwrite(chunk, sizeof(short), nsamples, out);
+      data_bytes += nsamples * sizeof(short);
+      nsamples = 0;
+    }
+  }
+  fwrite(chunk, sizeof(short), nsamples, out);
+  data_bytes += nsamples * sizeof(short);
+  write_wav_header(out, (unsigned long) data_bytes);
+  bool ok = ferror(out) == 0;
+  if (fclose(out) != 0) ok = false;
+  if (!ok) {
+    fprintf(stderr, "error writing %s\n", outname.c_str());
+    return 1;
+  }
+
+  double music = sim_seconds(t), cpu = (double)(clock() - start) / CLOCKS_PER_SEC;
+  printf("%s: %lu bytes, %d channels, %.1f seconds%s in %.2f seconds (%.0fx), %llu interrupts\n",
+         outname.c_str(), bytes, nchans, music,
+         Playtune::tune_playing ? " (truncated)" : "", cpu, cpu > 0 ? music / cpu : 0, sim_interrupts);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  int argn;
+  for (argn = 1; argn < argc && argv[argn][0] == '-'; ++argn) {
+    const char *arg = argv[argn] + 2;
+    switch (argv[argn][1]) {
+      case 'j': max_jobs = atoi(arg); break;
+      case 'r': sample_rate = strtoul(arg, NULL, 10); break;
+      case 'f': sim_f_cpu = (unsigned long)(atof(arg) * 1000000); break;
+      case 'c': max_chans = atoi(arg); break;
+      case 's': max_seconds = atof(arg); break;
+      case 'p': playlist = arg; break;
+      case 'o': output_dir = arg; break;
+      default:
+        fprintf(stderr, "unknown option %s\n", argv[argn]);
+        return 1;
+    }
+  }
+  if (argn >= argc || sample_rate == 0 || sim_f_cpu == 0) {
+    fprintf(stderr, "usage: playtune_render [-jN] [-rN] [-fN] [-cN] [-sN] [-pNAME] [-oDIR] file ...\n");
+    return 1;
+  }
+  std::vector<playtune_score> scores;
+  for (; argn < argc; ++argn)
+    if (!sim_load_scores(argv[argn], scores)) return 1;
+  if (playlist) {
+    printf("rendering a playlist of %u scores for the %s at %.1f Mhz\n",
+           (unsigned) scores.size(), sim_mcu_name(), sim_f_cpu / 1e6);
+    return render(scores, 0, scores.size(), playlist);
+  }
+  if (max_jobs <= 0) max_jobs = (int) sysconf(_SC_NPROCESSORS_ONLN);
+  if (max_jobs <= 0) max_jobs = 1;
+  printf("rendering %u scores for the %s at %.1f Mhz, %d at a time\n",
+         (unsigned) scores.size(), sim_mcu_name(), sim_f_cpu / 1e6, max_jobs);
+  fflush(stdout);
+
+  // The work queue: keep max_jobs renderings going until all are done.
+  size_t next = 0;
+  int running = 0, failures = 0, status;
+  while (next < scores.size() || running > 0) {
+    if (next < scores.size() && running < max_jobs) {
+      pid_t pid = fork();
+      if (pid == 0) {
+        int result = render(scores, next, 1, score_basename(scores[next]));
+        fflush(stdout);
+        _exit(result);
+      }
+      if (pid < 0) {
+        perror("fork");
+        return 1;
+      }
+      ++next;
+      ++running;
+    }
+    else if (wait(&status) > 0) {
+      --running;
+      if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) ++failures;
+    }
+  }
+  if (failures) fprintf(stderr, "%d of %u renderings failed\n", failures, (unsigned) scores.size());
+  return failures ? 1 : 0;
+}
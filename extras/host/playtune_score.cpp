@@ -0,0 +1,197 @@
+/**************************************************************************
+*
+*  Reading Playtune score bytestreams on the host computer.
+*  See playtune_score.h for the interface.
+*
+*  (C) Copyright 2026, the Playtune contributors. MIT License, as in Playtune.cpp
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "playtune_score.h"
+
+static bool read_file(const char *filename, std::string &contents) {
+  FILE *f = fopen(filename, "rb");
+  if (!f) {
+    fprintf(stderr, "can't open %s\n", filename);
+    return false;
+  }
+  char buf[8192];
+  size_t len;
+  while ((len = fread(buf, 1, sizeof(buf), f)) > 0) contents.append(buf, len);
+  fclose(f);
+  return true;
+}
+
+static void strip_comments(std::string &text) {
+  // Replace comments with blanks, leaving character and string literals alone.
+  for (size_t i = 0; i < text.size(); ++i) {
+    if (text[i] == '\'' || text[i] == '"') {
+      char quote = text[i];
+      for (++i; i < text.size() && text[i] != quote; ++i)
+        if (text[i] == '\\') ++i;
+    }
+    else if (text.compare(i, 2, "//") == 0) {
+      for (; i < text.size() && text[i] != '\n'; ++i) text[i] = ' ';
+    }
+    else if (text.compare(i, 2, "/*") == 0) {
+      size_t end = text.find("*/", i + 2);
+      end = end == std::string::npos ? text.size() : end + 2;
+      for (; i < end; ++i) if (text[i] != '\n') text[i] = ' ';
+      --i;
+    }
+  }
+}
+
+static bool parse_element(const std::string &token, unsigned char *value) {
+  // a decimal, hex, or octal number, or a character constant
+  if (token.size() == 3 && token[0] == '\'' && token[2] == '\'') {
+    *value = token[1];
+    return true;
+  }
+  char *end;
+  long n = strtol(token.c_str(), &end, 0);
+  if (token.empty() || *end != '\0' || n < -128 || n > 255) return false;
+  *value = (unsigned char) n;
+  return true;
+}
+
+static bool parse_arrays(const char *filename, std::string text, std::vector<playtune_score> &scores) {
+  // Look for declarations of the form  "... PROGMEM ... name [...] = { n, n, ... };"
+  size_t found = scores.size();
+  strip_comments(text);
+  size_t stmt_start = 0, pos;
+  while ((pos = text.find('{', stmt_start)) != std::string::npos) {
+    size_t end = text.find('}', pos);
+    if (end == std::string::npos) break;
+    std::string decl = text.substr(stmt_start, pos - stmt_start);
+    size_t semi = decl.find_last_of(";}");
+    if (semi != std::string::npos) decl.erase(0, semi + 1);
+    size_t bracket = decl.find('[');
+    if (decl.find("PROGMEM") != std::string::npos && bracket != std::string::npos
+        && text.find('{', pos + 1) > end) { // (not an array of structures)
+      size_t name_end = bracket;
+      while (name_end > 0 && isspace((unsigned char) decl[name_end - 1])) --name_end;
+      size_t name_start = name_end;
+      while (name_start > 0 && (isalnum((unsigned char) decl[name_start - 1]) || decl[name_start - 1] == '_'))
+        --name_start;
+      playtune_score score;
+      score.file = filename;
+      score.name = decl.substr(name_start, name_end - name_start);
+      std::string body = text.substr(pos + 1, end - pos - 1);
+      bool ok = true;
+      for (size_t i = 0; i < body.size() && ok;) {
+        size_t comma = body.find(',', i);
+        if (comma == std::string::npos) comma = body.size();
+        std::string token = body.substr(i, comma - i);
+        size_t first = token.find_first_not_of(" \t\r\n");
+        if (first != std::string::npos) {
+          token = token.substr(first, token.find_last_not_of(" \t\r\n") - first + 1);
+          unsigned char value;
+          if (parse_element(token, &value)) score.data.push_back(value);
+          else {
+            fprintf(stderr, "%s: skipping array %s: can't parse \"%s\"\n",
+                    filename, score.name.c_str(), token.c_str());
+            ok = false;
+          }
+        }
+        i = comma + 1;
+      }
+      if (ok && !score.data.empty()) scores.push_back(score);
+    }
+    stmt_start = end + 1;
+  }
+  if (scores.size() == found) {
+    fprintf(stderr, "%s: no PROGMEM score arrays found\n", filename);
+    return false;
+  }
+  return true;
+}
+
+bool load_scores(const char *filename, std::vector<playtune_score> &scores) {
+  std::string contents;
+  if (!read_file(filename, contents)) return false;
+  const char *ext = strrchr(filename, '.');
+  if (ext && strcmp(ext, ".bin") == 0) {
+    playtune_score score;
+    score.file = filename;
+    score.name = score_basename(score);
+    score.data.assign(contents.begin(), contents.end());
+    scores.push_back(score);
+    return true;
+  }
+  return parse_arrays(filename, contents, scores);
+}
+
+std::string score_basename(const playtune_score &score) {
+  std::string base = score.file;
+  size_t slash = base.find_last_of("/\\");
+  if (slash != std::string::npos) base.erase(0, slash + 1);
+  size_t dot = base.rfind('.');
+  if (dot != std::string::npos) base.erase(dot);
+  if (!score.name.empty() && score.name != base) base += "_" + score.name;
+  return base;
+}
+
+bool decode_score(const playtune_score &score, playtune_decoded &decoded, bool assume_volume) {
+  const std::vector<unsigned char> &data = score.data;
+  unsigned pos = 0;
+  decoded = playtune_decoded();
+  decoded.volume_present = assume_volume;
+  if (data.size() >= 6 && data[0] == 'P' && data[1] == 't') {
+    decoded.header_present = true;
+    decoded.hdr_length = data[2];
+    decoded.f1 = data[3];
+    decoded.f2 = data[4];
+    decoded.num_tgens = data[5];
+    decoded.volume_present = (decoded.f1 & HDR_F1_VOLUME_PRESENT) != 0;
+    pos = decoded.hdr_length;
+  }
+  unsigned long time = 0;
+  while (1) {
+    if (pos >= data.size()) {
+      decoded.error = "the score runs off the end without a stop or restart command";
+      decoded.duration = time;
+      return false;
+    }
+    playtune_cmd cmd = playtune_cmd();
+    cmd.offset = pos;
+    cmd.time = time;
+    unsigned char b = data[pos++];
+    unsigned args = 0;
+    if (b < 0x80) {
+      cmd.opcode = CMD_WAIT;
+      args = 1;
+    }
+    else {
+      cmd.opcode = b & 0xf0;
+      cmd.chan = b & 0x0f;
+      if (cmd.opcode == CMD_PLAYNOTE) args = decoded.volume_present ? 2 : 1;
+      else if (cmd.opcode == CMD_INSTRUMENT) args = 1;
+    }
+    if (pos + args > data.size()) {
+      decoded.error = "the score ends in the middle of a command";
+      decoded.duration = time;
+      return false;
+    }
+    if (cmd.opcode == CMD_WAIT) {
+      cmd.wait = ((unsigned) b << 8) | data[pos];
+      time += cmd.wait;
+    }
+    else if (cmd.opcode == CMD_PLAYNOTE) {
+      cmd.note = data[pos];
+      if (decoded.volume_present) cmd.volume = data[pos + 1];
+    }
+    else if (cmd.opcode == CMD_INSTRUMENT) cmd.instrument = data[pos];
+    pos += args;
+    cmd.length = pos - cmd.offset;
+    decoded.cmds.push_back(cmd);
+    if (cmd.opcode == CMD_STOP || cmd.opcode == CMD_RESTART) break;
+    // (Playtune.cpp ignores the other opcodes, and so do we)
+  }
+  decoded.duration = time;
+  return true;
+}
@@ -0,0 +1,71 @@
+/**************************************************************************
+*
+*  Reading Playtune score bytestreams on the host computer.
+*
+*  Scores can come from Arduino sketches or C files with PROGMEM byte
+*  arrays like the ones Miditones generates, in which case every such
+*  array in the file is a separate score, or from binary files (.bin)
+*  that contain just the bytestream.
+*
+*  (C) Copyright 2026, the Playtune contributors. MIT License, as in Playtune.cpp
+*
+**************************************************************************/
+
+#ifndef playtune_score_h
+#define playtune_score_h
+
+#include <string>
+#include <vector>
+
+struct playtune_score {
+  std::string file;                  // the file it came from
+  std::string name;                  // the array name, or the file name for binary files
+  std::vector<unsigned char> data;   // the bytestream, including any header
+};
+
+// The decoded form of a score
+
+#define CMD_WAIT        0x00  /* wait: not really a command byte, but any value < 0x80 */
+#define CMD_PLAYNOTE    0x90  /* the rest are as in Playtune.cpp */
+#define CMD_STOPNOTE    0x80
+#define CMD_INSTRUMENT  0xc0
+#define CMD_RESTART     0xe0
+#define CMD_STOP        0xf0
+
+#define HDR_F1_VOLUME_PRESENT 0x80
+#define HDR_F1_INSTRUMENTS_PRESENT 0x40
+#define HDR_F1_PERCUSSION_PRESENT 0x20
+
+struct playtune_cmd {
+  unsigned offset;          // where it starts in the bytestream
+  unsigned length;          // how many bytes it takes
+  unsigned long time;       // msec from the start of the score
+  unsigned char opcode;     // CMD_xxx
+  unsigned char chan;       // for notes and instruments
+  unsigned char note;       // for CMD_PLAYNOTE
+  unsigned char volume;     // for CMD_PLAYNOTE, if volume is present
+  unsigned char instrument; // for CMD_INSTRUMENT
+  unsigned wait;            // msec, for CMD_WAIT
+};
+
+struct playtune_decoded {
+  bool header_present;      // the optional file header
+  unsigned char hdr_length, f1, f2, num_tgens;
+  bool volume_present;      // are there volume bytes after notes?
+  std::vector<playtune_cmd> cmds;  // through the final CMD_STOP or CMD_RESTART
+  unsigned long duration;   // msec
+  std::string error;        // why decoding failed
+};
+
+// Decode one pass through a score the way Playtune.cpp interprets it.
+// Returns false, with decoded.error set, if the score doesn't end properly.
+bool decode_score (const playtune_score &score, playtune_decoded &decoded, bool assume_volume = false);
+
+// Add the scores in a file to the list. Returns false, with a message
+// to stderr, if the file can't be read or has no scores.
+bool load_scores (const char *filename, std::vector<playtune_score> &scores);
+
+// The file name without its directory or extension, for naming output files
+std::string score_basename (const playtune_score &score);
+
+#endif
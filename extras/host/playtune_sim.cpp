@@ -0,0 +1,522 @@
+/**************************************************************************
+*
+*  A virtual AVR microcontroller that runs the real Playtune.cpp code.
+*  See playtune_sim.h for the interface.
+*
+*  (C) Copyright 2026, the Playtune contributors. MIT License, as in Playtune.cpp
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <Arduino.h>
+#include "playtune_sim.h"
+
+#include "../../Playtune.cpp"   // the real thing
+
+unsigned long sim_f_cpu = 16000000UL;
+unsigned long long sim_interrupts = 0;
+sim_time_t sim_sleep_cycles = 0;
+unsigned long long sim_vector_counts[SIM_NUM_TIMERS][SIM_NUM_SOURCES];
+#if TUNE_ARPEGGIO
+unsigned long long sim_arpeggio_turns = 0, sim_arpeggio_alarms = 0;
+#endif
+volatile uint8_t sim_ports[SIM_NUM_PORTS];
+sim_serial Serial;
+
+static sim_time_t now = 0;
+static bool in_interrupt = false;
+static int interrupt_timer = -1, interrupt_source = -1;  // the interrupt routine running
+
+struct sim_timer_t {
+  bool present;
+  unsigned max;              // counter maximum: 0xff, 0x3ff, or 0xffff
+  sim_time_t base_time;      // time of a clock tick at which...
+  unsigned base_count;       // ...the counter had this value
+  sim_time_t next[SIM_NUM_SOURCES];  // when each enabled interrupt will happen next
+  sim_time_t match[SIM_NUM_SOURCES]; // when each modeled flag will next be set
+  bool flag[SIM_NUM_SOURCES];        // a match that hasn't been taken or cleared
+  unsigned long restarts;    // how many times a note was started on it
+  sim_reg *tccra, *tccrb, *tcnt, *ocra, *ocrb, *timsk;
+  void (*vectors[SIM_NUM_SOURCES]) (void);
+} timers[SIM_NUM_TIMERS];
+
+//  the registers
+
+#define SIM_TIMER_REGS(n) \
+  sim_reg TCCR##n##A(n, SIM_TCCRA), TCCR##n##B(n, SIM_TCCRB), TCNT##n(n, SIM_TCNT), \
+          OCR##n##A(n, SIM_OCRA), OCR##n##B(n, SIM_OCRB)
+
+#if defined(__AVR_ATmega8__)
+SIM_TIMER_REGS(1);
+sim_reg TCCR2(2, SIM_TCCRB), TCNT2(2, SIM_TCNT), OCR2(2, SIM_OCRA), TIMSK(SIM_ALL_TIMERS, SIM_TIMSK);
+sim_reg TIFR(SIM_ALL_TIMERS, SIM_TIFR);
+#define MCU_NAME "ATmega8"
+#else
+SIM_TIMER_REGS(0);
+SIM_TIMER_REGS(1);
+sim_reg TIMSK0(0, SIM_TIMSK), TIMSK1(1, SIM_TIMSK), TIFR1(1, SIM_TIFR);
+#if !defined(__AVR_ATmega32U4__)
+SIM_TIMER_REGS(2);
+sim_reg TIMSK2(2, SIM_TIMSK);
+#endif
+#if defined(__AVR_ATmega1280__)||defined(__AVR_ATmega2560__)||defined(__AVR_ATmega32U4__)
+SIM_TIMER_REGS(3);
+SIM_TIMER_REGS(4);
+sim_reg TIMSK3(3, SIM_TIMSK), TIMSK4(4, SIM_TIMSK);
+#endif
+#if defined(__AVR_ATmega1280__)||defined(__AVR_ATmega2560__)
+SIM_TIMER_REGS(5);
+sim_reg TIMSK5(5, SIM_TIMSK);
+#define MCU_NAME "ATmega2560"
+#endif
+#if defined(__AVR_ATmega32U4__)
+// The Arduino core leaves timer 4 in phase and frequency correct PWM mode
+sim_reg TCCR4D(4, SIM_TCCRD, 1 << WGM40), OCR4C(4, SIM_OCRC, 0xff);
+#define MCU_NAME "ATmega32U4"
+#endif
+#if !defined(MCU_NAME)
+#define MCU_NAME "ATmega328P"
+#endif
+#endif
+
+static void setup_timer(int n, sim_reg *tccra, sim_reg *tccrb, sim_reg *tcnt,
+                        sim_reg *ocra, sim_reg *ocrb, sim_reg *timsk, unsigned max,
+                        void (*compa)(void), void (*compb)(void), void (*ovf)(void)) {
+  sim_timer_t *t = &timers[n];
+  t->present = true;
+  t->max = max;
+  t->tccra = tccra; t->tccrb = tccrb; t->tcnt = tcnt;
+  t->ocra = ocra; t->ocrb = ocrb; t->timsk = timsk;
+  t->vectors[SIM_COMPA] = compa;
+  t->vectors[SIM_COMPB] = compb;
+  t->vectors[SIM_OVF] = ovf;
+  for (int s = 0; s < SIM_NUM_SOURCES; ++s) t->next[s] = t->match[s] = SIM_NEVER;
+}
+
+#define SETUP_TIMER(n, max) \
+  setup_timer(n, &TCCR##n##A, &TCCR##n##B, &TCNT##n, &OCR##n##A, &OCR##n##B, &TIMSK##n, max, \
+              sim_vect_timer##n##_compa, sim_vect_timer##n##_compb, sim_vect_timer##n##_ovf)
+
+static struct sim_init_t {
+  sim_init_t() {
+#if defined(__AVR_ATmega8__)
+    setup_timer(1, &TCCR1A, &TCCR1B, &TCNT1, &OCR1A, &OCR1B, &TIMSK, 0xffff,
+                sim_vect_timer1_compa, sim_vect_timer1_compb, sim_vect_timer1_ovf);
+    setup_timer(2, NULL, &TCCR2, &TCNT2, &OCR2, NULL, &TIMSK, 0xff,
+                sim_vect_timer2_compa, NULL, sim_vect_timer2_ovf);
+#else
+    SETUP_TIMER(0, 0xff);
+    SETUP_TIMER(1, 0xffff);
+#if !defined(__AVR_ATmega32U4__)
+    SETUP_TIMER(2, 0xff);
+#endif
+#if defined(__AVR_ATmega1280__)||defined(__AVR_ATmega2560__)
+    SETUP_TIMER(3, 0xffff);
+    SETUP_TIMER(4, 0xffff);
+    SETUP_TIMER(5, 0xffff);
+#endif
+#if defined(__AVR_ATmega32U4__)
+    SETUP_TIMER(3, 0xffff);
+    SETUP_TIMER(4, 0x3ff);
+#endif
+#endif
+  }
+} sim_init;
+
+const char *sim_mcu_name(void) {
+  return MCU_NAME;
+}
+
+//-----------------------------------------------
+//  Timer modeling
+//-----------------------------------------------
+
+static bool timer_is_32u4_timer4(int n) {
+#if defined(__AVR_ATmega32U4__)
+  return n == 4;
+#else
+  (void) n;
+  return false;
+#endif
+}
+
+static unsigned long timer_prescale(int n) {  // clocks per tick, or 0 if stopped
+  unsigned cs = timers[n].tccrb->value;
+  static const unsigned long normal[8] = { 0, 1, 8, 64, 256, 1024, 0, 0 };  // 6, 7 are external clocks
+  static const unsigned long async2[8] = { 0, 1, 8, 32, 64, 128, 256, 1024 };
+  if (timer_is_32u4_timer4(n)) { // CS43..CS40 select 1, 2, 4, ... 16384
+    cs &= 0x0f;
+    return cs ? 1UL << (cs - 1) : 0;
+  }
+  return n == 2 ? async2[cs & 7] : normal[cs & 7];
+}
+
+static unsigned timer_top(int n) {  // the counter goes to 0 after reaching this
+  sim_timer_t *t = &timers[n];
+#if defined(__AVR_ATmega32U4__)
+  if (n == 4) {
+    // TOP is always OCR4C. In the dual-slope mode the counter goes up and back
+    // down, which takes 2*OCR4C ticks; we model that as one slope twice as long.
+    if (TCCR4D.value & (1 << WGM40)) return OCR4C.value ? 2 * OCR4C.value - 1 : 0;
+    return OCR4C.value;
+  }
+#endif
+  bool ctc;
+#if defined(__AVR_ATmega8__)
+  if (n == 2) ctc = (TCCR2.value & (1 << WGM21)) != 0;
+  else
+#endif
+    if (t->max == 0xff) ctc = (t->tccra->value & 3) == 2 && !(t->tccrb->value & 0x08); // WGMx1
+    else ctc = (t->tccra->value & 3) == 0 && (t->tccrb->value & 0x18) == 0x08;        // WGMx2
+  // Modes that Playtune doesn't use are modeled as normal mode.
+  return ctc ? t->ocra->value & t->max : t->max;
+}
+
+static unsigned timer_count_after(int n, unsigned count, sim_time_t ticks) {
+  // The counter wraps to zero after TOP, unless it was already above TOP,
+  // in which case it first has to count to its maximum value.
+  unsigned top = timer_top(n), max = timers[n].max;
+  if (count <= top) return (count + ticks) % ((sim_time_t)top + 1);
+  sim_time_t to_wrap = max - count + 1;
+  if (ticks < to_wrap) return count + ticks;
+  return (ticks - to_wrap) % ((sim_time_t)top + 1);
+}
+
+static sim_time_t timer_ticks_until(int n, unsigned count, unsigned value) {
+  // the number of ticks (at least 1) until the counter becomes "value", or 0 if never
+  unsigned top = timer_top(n), max = timers[n].max;
+  if (count <= top) {
+    if (value > top) return 0;
+    sim_time_t ticks = (value + (sim_time_t)top + 1 - count) % ((sim_time_t)top + 1);
+    return ticks ? ticks : (sim_time_t)top + 1;
+  }
+  if (value > count) return value - count;
+  if (value <= top) return (sim_time_t)(max - count + 1) + value;
+  return 0;
+}
+
+static bool timer_enabled(int n, int source) {
+  static const uint8_t enable_bits[SIM_NUM_SOURCES] = { 1, 2, 0 };  // OCIExA, OCIExB, TOIEx
+  unsigned timsk = timers[n].timsk->value;
+#if defined(__AVR_ATmega8__)
+  if (n == 1) {
+    static const uint8_t bits1[SIM_NUM_SOURCES] = { OCIE1A, OCIE1B, TOIE1 };
+    return (timsk >> bits1[source]) & 1;
+  }
+  if (n == 2) return source == SIM_COMPA ? (timsk >> OCIE2) & 1 : source == SIM_OVF ? (timsk >> 6) & 1 : false;
+#endif
+  if (timer_is_32u4_timer4(n)) {
+    static const uint8_t bits4[SIM_NUM_SOURCES] = { 6, 5, 2 };  // OCIE4A, OCIE4B, TOIE4
+    return (timsk >> bits4[source]) & 1;
+  }
+  return (timsk >> enable_bits[source]) & 1;
+}
+
+static bool timer_has_flag(int n, int source) {
+  // Only timer 1's compare match flags are modeled. Its counter keeps running while
+  // its interrupts are off, so Playtune clears them before turning the interrupts on.
+  return n == 1 && source != SIM_OVF;
+}
+
+static void timer_latch(int n) {  // set the flags of the matches that have happened
+  sim_timer_t *t = &timers[n];
+  for (int s = 0; s < SIM_NUM_SOURCES; ++s)
+    if (timer_has_flag(n, s) && t->match[s] <= now) t->flag[s] = true;
+}
+
+static void timer_rebase(int n) {  // bring the counter up to the current time
+  sim_timer_t *t = &timers[n];
+  unsigned long prescale = timer_prescale(n);
+  if (prescale == 0) {
+    t->base_time = now;
+    return;
+  }
+  sim_time_t ticks = (now - t->base_time) / prescale;
+  t->base_count = timer_count_after(n, t->base_count, ticks);
+  t->base_time += ticks * prescale;
+}
+
+static void timer_schedule(int n, int source) {  // find the next time for an interrupt
+  sim_timer_t *t = &timers[n];
+  unsigned long prescale = timer_prescale(n);
+  bool has_flag = timer_has_flag(n, source);
+  timer_latch(n);
+  if (t->next[source] <= now && timer_enabled(n, source))
+    return;  // it's pending: another interrupt at the same time is being taken first
+  t->next[source] = t->match[source] = SIM_NEVER;
+  if (prescale == 0 || (!has_flag && !timer_enabled(n, source))) return;
+  sim_time_t ticks_now = (now - t->base_time) / prescale;
+  unsigned count = timer_count_after(n, t->base_count, ticks_now);
+  sim_time_t ticks;
+  switch (source) {
+    case SIM_COMPA:
+      ticks = timer_ticks_until(n, count, t->ocra->value & t->max);
+      break;
+    case SIM_COMPB:
+      ticks = t->ocrb ? timer_ticks_until(n, count, t->ocrb->value & t->max) : 0;
+      break;
+    default: // overflow: the counter went from its maximum to 0
+      if (timer_top(n) == t->max) ticks = timer_ticks_until(n, count, 0);
+      else ticks = count > timer_top(n) ? t->max - count + 1 : 0;
+      break;
+  }
+  sim_time_t when = ticks ? t->base_time + (ticks_now + ticks) * prescale : SIM_NEVER;
+  if (has_flag) t->match[source] = when;
+  if (!timer_enabled(n, source)) return;
+  t->next[source] = has_flag && t->flag[source] ? now : when;  // a flag set while it was off is taken at once
+}
+
+static void timer_schedule_all(int n) {
+  for (int s = 0; s < SIM_NUM_SOURCES; ++s) timer_schedule(n, s);
+}
+
+//  register access
+
+unsigned sim_reg::read(void) const {
+  // Of the interrupt flags, only timer 1's OCF1A and OCF1B are modeled: a compare match
+  // sets them, and taking the interrupt or writing a 1 to them clears them. The others
+  // always read as 0.
+  if (kind == SIM_TIFR) {
+    timer_latch(1);
+    return timers[1].flag[SIM_COMPA] << OCF1A | timers[1].flag[SIM_COMPB] << OCF1B;
+  }
+  if (kind == SIM_TCNT) {
+    unsigned long prescale = timer_prescale(timer);
+    if (prescale == 0) return timers[timer].base_count;
+    return timer_count_after(timer, timers[timer].base_count, (now - timers[timer].base_time) / prescale);
+  }
+  return value;
+}
+
+void sim_reg::write(unsigned long x) {
+  if (kind == SIM_TIFR) {
+    static const uint8_t bits[2] = { OCF1A, OCF1B };
+    timer_latch(1);
+    for (int s = SIM_COMPA; s <= SIM_COMPB; ++s)
+      if (x & (1 << bits[s])) {  // forget the match, and the interrupt if it was pending
+        timers[1].flag[s] = false;
+        timers[1].next[s] = timers[1].match[s] = SIM_NEVER;
+      }
+    timer_schedule_all(1);
+    return;
+  }
+  if (timer == SIM_ALL_TIMERS) {  // the ATmega8 TIMSK
+    for (int n = 0; n < SIM_NUM_TIMERS; ++n)
+      if (timers[n].present) timer_latch(n);
+    value = x & 0xff;
+    for (int n = 0; n < SIM_NUM_TIMERS; ++n)
+      if (timers[n].present) timer_schedule_all(n);
+    return;
+  }
+  timer_latch(timer);
+  timer_rebase(timer);
+  value = x & (kind == SIM_TCNT || (kind >= SIM_OCRA && kind <= SIM_OCRC) ? timers[timer].max : 0xff);
+  if (kind == SIM_TCNT) {
+    timers[timer].base_count = value;
+    timers[timer].base_time = now;
+    ++timers[timer].restarts;
+  }
+  // Timer 1 plays notes without restarting the counter, by moving the compare value
+  // ahead in its interrupt routine, so a compare value set anywhere else is a new note.
+  else if (kind == SIM_OCRA && timer == 1 && !(interrupt_timer == 1 && interrupt_source == SIM_COMPA))
+    ++timers[timer].restarts;
+  timer_schedule_all(timer);
+}
+
+//-----------------------------------------------
+//  Running the virtual clock
+//-----------------------------------------------
+
+sim_time_t sim_now(void) {
+  return now;
+}
+
+double sim_seconds(sim_time_t time) {
+  return (double) time / sim_f_cpu;
+}
+
+sim_time_t sim_next_event(void) {
+  sim_time_t next = SIM_NEVER;
+  for (int n = 0; n < SIM_NUM_TIMERS; ++n)
+    if (timers[n].present)
+      for (int s = 0; s < SIM_NUM_SOURCES; ++s)
+        if (timers[n].next[s] < next) next = timers[n].next[s];
+  return next;
+}
+
+#if TUNE_ARPEGGIO
+static void count_arpeggio(void) {
+  // The alarm is about to go off: will it give a turn, and is that all it is for?
+  unsigned long now = tune_wait_now();
+  if (!Playtune::tune_playing || !ARP_SHARING || (long)(arp_deadline - now) > WAIT_MARGIN) return;
+  ++sim_arpeggio_turns;
+  if ((long)(score_deadline - now) <= WAIT_MARGIN) return;
+#if TUNE_DELAY
+  if (doing_delay && (long)(delay_deadline - now) <= WAIT_MARGIN) return;
+#endif
+#if TUNE_LINK
+  if (link_mode == LINK_LEADING && (long)(link_deadline - now) <= WAIT_MARGIN) return;
+#endif
+  ++sim_arpeggio_alarms;
+}
+#endif
+
+static void take_interrupt(sim_time_t time) {
+  // Interrupts that are due at the same time are taken in the order of their
+  // vector addresses, which on all these processors puts timer 2 first.
+  static const uint8_t priority[SIM_NUM_TIMERS] = { 2, 1, 0, 3, 4, 5 };
+  for (int i = 0; i < SIM_NUM_TIMERS; ++i) {
+    int n = priority[i];
+    for (int s = 0; s < SIM_NUM_SOURCES; ++s)
+      if (timers[n].next[s] == time) {
+        ++sim_interrupts;
+        ++sim_vector_counts[n][s];
+        in_interrupt = true;
+        interrupt_timer = n;
+        interrupt_source = s;
+        timers[n].next[s] = timers[n].match[s] = SIM_NEVER;  // taking it clears the flag
+        timers[n].flag[s] = false;
+#if TUNE_ARPEGGIO
+        if (n == 1 && s == SIM_COMPB) count_arpeggio();
+#endif
+        if (timers[n].vectors[s]) timers[n].vectors[s]();
+        interrupt_timer = interrupt_source = -1;
+        in_interrupt = false;
+        timer_schedule(n, s);
+        return;
+      }
+  }
+}
+
+void sim_run_until(sim_time_t time) {
+  sim_time_t next;
+  while ((next = sim_next_event()) <= time) {
+    now = next;
+    take_interrupt(next);
+  }
+  if (time > now) now = time;
+}
+
+void sim_cli(void) {
+}
+
+void sim_sei(void) {
+  // The foreground code takes no time, so only the interrupts that are due now can happen.
+  if (!in_interrupt) sim_run_until(now);
+}
+
+void sim_sleep(void) {
+  // Let the clock run to the next interrupt.
+  if (in_interrupt) return;
+  sim_time_t next = sim_next_event();
+  if (next == SIM_NEVER) {
+    fprintf(stderr, "simulator: sleeping with no timer interrupts enabled\n");
+    exit(2);
+  }
+  sim_sleep_cycles += next - now;
+  sim_run_until(next);
+}
+
+//-----------------------------------------------
+//  Pins and Playtune's channels
+//-----------------------------------------------
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  if (val) sim_ports[digitalPinToPort(pin)] |= digitalPinToBitMask(pin);
+  else sim_ports[digitalPinToPort(pin)] &= ~digitalPinToBitMask(pin);
+}
+
+bool sim_pin_level(byte pin) {
+  return (sim_ports[digitalPinToPort(pin)] & digitalPinToBitMask(pin)) != 0;
+}
+
+int sim_num_chans(void) {
+  return _tune_num_chans;
+}
+
+byte sim_chan_pin(int chan) {
+  return _tune_pins[chan];
+}
+
+int sim_chan_timer(int chan) {
+  return pgm_read_byte(tune_pin_to_timer_PGM + chan);
+}
+
+bool sim_chan_sounding(int chan) {
+  return timer_enabled(sim_chan_timer(chan), SIM_COMPA);
+}
+
+//-----------------------------------------------
+//  Looking at the timers
+//-----------------------------------------------
+
+unsigned sim_timer_ocr(int timer) {
+#if defined(__AVR_ATmega32U4__)
+  if (timer == 4) return OCR4C.value;
+#endif
+  if (timer == 1) return timer1_half_period;  // OCR1A moves ahead at every toggle
+  return timers[timer].ocra->value;
+}
+
+unsigned long sim_timer_prescale(int timer) {
+  return timer_prescale(timer);
+}
+
+unsigned long sim_timer_restarts(int timer) {
+  return timers[timer].restarts;
+}
+
+#if TESLA_COIL
+void sim_tesla_limits(sim_tesla_t *limits) {
+  limits->pin = TESLA_PIN;
+  limits->pulse = (sim_time_t) TESLA_TICKS(TESLA_PULSE_USEC) * 8;  // the timers run at clk/8
+  limits->merge = (sim_time_t) TESLA_TICKS(TESLA_MERGE_USEC) * 8;
+  limits->voice = (sim_time_t) TESLA_TICKS(TESLA_VOICE_USEC) * 8;
+  limits->spacing = (sim_time_t) TESLA_SPACING * 8;
+  limits->burst = TESLA_BURST;
+}
+#endif
+
+//-----------------------------------------------
+//  Scores
+//-----------------------------------------------
+
+bool sim_load_scores(const char *filename, std::vector<playtune_score> &scores) {
+  size_t first = scores.size();
+  if (!load_scores(filename, scores)) return false;
+  for (size_t i = first; i < scores.size(); ++i) {
+    playtune_decoded decoded;
+    if (!decode_score(scores[i], decoded, ASSUME_VOLUME)) {
+      fprintf(stderr, "%s: %s: %s\n", filename, scores[i].name.c_str(), decoded.error.c_str());
+      return false;
+    }
+    scores[i].data.push_back(CMD_STOP);  // in flash, something always follows
+    scores[i].data.insert(scores[i].data.end(), sizeof(file_hdr_t), 0);
+  }
+  return true;
+}
+
+//-----------------------------------------------
+//  Debugging output
+//-----------------------------------------------
+
+void sim_serial::print(const char *s) {
+  fputs(s, stderr);
+}
+
+void sim_serial::print(char c) {
+  fputc(c, stderr);
+}
+
+void sim_serial::print(long n, int base) {
+  if (n < 0) {
+    fputc('-', stderr);
+    n = -n;
+  }
+  print((unsigned long) n, base);
+}
+
+void sim_serial::print(unsigned long n, int base) {
+  fprintf(stderr, base == HEX ? "%lX" : "%lu", n);
+}
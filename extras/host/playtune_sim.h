@@ -0,0 +1,76 @@
+/**************************************************************************
+*
+*  A virtual AVR microcontroller that runs the real Playtune.cpp code.
+*
+*  Time is counted in processor clock cycles. Nothing happens between
+*  timer events, so the simulator jumps from one event to the next and
+*  calls the interrupt routine that the event triggers. The timers are
+*  modeled well enough to reproduce what Playtune does with them: CTC and
+*  normal modes, the prescalers, the counter running past a lowered TOP,
+*  and the compare-match and overflow interrupts.
+*
+*  The Playtune state is global, so there is one simulated processor per
+*  program. The tools that render several scores use separate processes.
+*
+*  (C) Copyright 2026, the Playtune contributors. MIT License, as in Playtune.cpp
+*
+**************************************************************************/
+
+#ifndef playtune_sim_h
+#define playtune_sim_h
+
+#include "../../Playtune.h"
+#include "playtune_score.h"
+
+typedef unsigned long long sim_time_t;  // processor clock cycles since reset
+#define SIM_NEVER (~(sim_time_t)0)
+
+#define SIM_NUM_TIMERS 6
+enum sim_source {  // the interrupt sources of each timer
+  SIM_COMPA, SIM_COMPB, SIM_OVF, SIM_NUM_SOURCES
+};
+
+extern unsigned long sim_f_cpu;              // processor clock, default 16 Mhz
+extern unsigned long long sim_interrupts;    // interrupts taken so far
+extern sim_time_t sim_sleep_cycles;          // time spent sleeping in avr/sleep.h's sleep_cpu()
+extern unsigned long long sim_vector_counts[SIM_NUM_TIMERS][SIM_NUM_SOURCES];
+
+sim_time_t sim_now (void);                // the current virtual time
+sim_time_t sim_next_event (void);         // time of the next interrupt, or SIM_NEVER
+void sim_run_until (sim_time_t time);     // take all interrupts up to "time"
+double sim_seconds (sim_time_t time);     // convert cycles to seconds
+
+int sim_num_chans (void);                 // how many tone generators were assigned
+byte sim_chan_pin (int chan);             // the output pin of a tone generator
+int sim_chan_timer (int chan);            // the timer of a tone generator
+bool sim_chan_sounding (int chan);        // is a tone generator playing a note?
+bool sim_pin_level (byte pin);            // the current level of an output pin
+const char *sim_mcu_name (void);          // the processor we were compiled for
+
+// Add the scores in a file to the list, like load_scores(), but refuse scores that
+// don't end with a stop or restart command the way Playtune.cpp reads them. Each
+// score is followed by a stop command and zeros, so the library can't read past it.
+bool sim_load_scores (const char *filename, std::vector<playtune_score> &scores);
+
+unsigned sim_timer_ocr (int timer);              // the compare value that sets the frequency
+unsigned long sim_timer_prescale (int timer);    // clocks per tick, or 0 if stopped
+unsigned long sim_timer_restarts (int timer);    // how many times a note was started on it
+
+#if TESLA_COIL
+struct sim_tesla_t {  // the Tesla coil limits that Playtune.cpp was compiled with
+  byte pin;             // the pin that gets the pulses
+  sim_time_t pulse;     // the on-time of a pulse, in clock cycles
+  sim_time_t merge;     // edges this soon after the start of a pulse are merged into it
+  sim_time_t voice;     // the shortest time between the pulses of one tone generator
+  sim_time_t spacing;   // the average time between pulses at the duty limit
+  int burst;            // how many pulses may come faster than that
+};
+void sim_tesla_limits (sim_tesla_t *limits);
+#endif
+
+#if TUNE_ARPEGGIO
+extern unsigned long long sim_arpeggio_turns;   // turns the notes sharing timer 1 were given
+extern unsigned long long sim_arpeggio_alarms;  // timer 1 alarms that were only for a turn
+#endif
+
+#endif
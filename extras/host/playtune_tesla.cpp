@@ -0,0 +1,191 @@
+/**************************************************************************
+*
+*  playtune_tesla: check the Tesla coil pulses that Playtune makes
+*
+*  With TESLA_COIL set, Playtune turns the rising edges of its tone
+*  generators into pulses of fixed length on one pin, which drives the
+*  interrupter of a Tesla coil, and it drops or merges edges to keep the
+*  coil within its limits. This plays scores through the real Playtune
+*  code on the simulated processor, watches the tone generators and the
+*  pulse pin, and checks the pulses against the limits Playtune.cpp was
+*  compiled with:
+*
+*     - every pulse has the configured on-time
+*     - every pulse starts at a rising edge of a tone generator
+*     - no pulse starts within the merge time of the one before it
+*     - the pulses of each tone generator are far enough apart; when several
+*       edges come at once, the pulse is counted for the first one that may fire
+*     - all together, the pulses never go faster than the duty limit allows,
+*       using the same rule (the generic cell rate algorithm) as Playtune
+*
+*  For each score it shows how many edges there were, how many became
+*  pulses, how many were merged into a pulse that had just started, and
+*  how many were dropped, and the average duty and the highest duty over
+*  any 100 msec.
+*
+*  Usage: playtune_tesla [-fN] [-cN] [-sN] [-v] file ...
+*     -fN   processor clock in Mhz (default 16)
+*     -cN   use only N tone generators (default: all the processor has)
+*     -sN   stop after N seconds if the score hasn't ended (default 600)
+*     -v    list every pulse
+*
+*  The exit status is 1 if any pulse breaks a limit.
+*
+*  Build it with TESLA_COIL set, for the processor you want to simulate:
+*     g++ -O2 -I. -D__AVR_ATmega2560__ -DTESLA_COIL=1 -o playtune_tesla
+*         playtune_tesla.cpp playtune_sim.cpp playtune_score.cpp
+*
+*  (C) Copyright 2026, the Playtune contributors. MIT License, as in Playtune.cpp
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <deque>
+#include "playtune_sim.h"
+#include "playtune_score.h"
+
+#if !TESLA_COIL
+#error "build playtune_tesla with -DTESLA_COIL=1"
+#endif
+
+#define MAX_CHANS 16
+#define MAX_ERRORS 10      // violations to show for each score
+#define DUTY_WINDOW 0.1    // seconds, for the peak duty
+#define TICK 8             // Playtune measures in ticks of clk/8, so times may be off by one
+
+static int max_chans = MAX_CHANS;
+static double max_seconds = 600;
+static bool verbose = false;
+
+static Playtune pt;
+static sim_tesla_t limits;
+
+struct tesla_stats_t {
+  unsigned long edges, pulses, merged, errors;
+  sim_time_t on_time, peak_on_time;
+  sim_time_t min_width, max_width;
+};
+
+static void violation(tesla_stats_t *stats, sim_time_t time, sim_time_t start, const char *what) {
+  if (++stats->errors <= MAX_ERRORS)
+    printf("   at %.6f s: %s\n", sim_seconds(time - start), what);
+}
+
+static void check_score(const playtune_score &score, tesla_stats_t *stats) {
+  int nchans = sim_num_chans();
+  bool levels[MAX_CHANS], pulse_level;
+  sim_time_t last_fired[MAX_CHANS];        // when each tone generator last fired a pulse
+  sim_time_t start = sim_now(), stop_time = start + (sim_time_t)(max_seconds * sim_f_cpu);
+  sim_time_t pulse_start = 0, duty_next = start;
+  bool pulsed = false;
+  std::deque<sim_time_t> window;           // the pulses that started in the last DUTY_WINDOW
+  sim_time_t window_length = (sim_time_t)(DUTY_WINDOW * sim_f_cpu);
+
+  memset(stats, 0, sizeof(*stats));
+  stats->min_width = SIM_NEVER;
+  for (int chan = 0; chan < nchans; ++chan) {
+    levels[chan] = sim_pin_level(sim_chan_pin(chan));
+    last_fired[chan] = start - limits.voice;
+  }
+  pulse_level = sim_pin_level(limits.pin);
+  pt.tune_playscore(&score.data[0]);
+  while (1) {
+    sim_time_t now = sim_now();
+    // the tone generators that had a rising edge just now, in the order their interrupts are taken
+    int rising[MAX_CHANS], nrising = 0;
+    for (int chan = 0; chan < nchans; ++chan) {
+      bool level = sim_pin_level(sim_chan_pin(chan));
+      if (level && !levels[chan]) rising[nrising++] = chan;
+      levels[chan] = level;
+    }
+    stats->edges += nrising;
+    bool level = sim_pin_level(limits.pin);
+    if (level && !pulse_level) {  // a pulse started
+      if (nrising == 0) violation(stats, now, start, "a pulse started without an edge");
+      if (pulsed && now + TICK - pulse_start < limits.merge) violation(stats, now, start, "a pulse started too soon after the last one");
+      int fired = -1;
+      for (int i = 0; i < nrising && fired < 0; ++i)
+        if (now + TICK - last_fired[rising[i]] >= limits.voice) fired = rising[i];
+      if (nrising && fired < 0) violation(stats, now, start, "a tone generator pulsed too often");
+      if (fired >= 0) last_fired[fired] = now;
+      if (duty_next > now + TICK + (limits.burst - 1) * limits.spacing) violation(stats, now, start, "the pulses went over the duty limit");
+      duty_next = (duty_next > now ? duty_next : now) + limits.spacing;
+      while (!window.empty() && window.front() + window_length <= now) window.pop_front();
+      window.push_back(now);
+      if (window.size() * limits.pulse > stats->peak_on_time) stats->peak_on_time = window.size() * limits.pulse;
+      if (verbose) printf("   %12.6f s: pulse for tone generator %d, %d edges\n", sim_seconds(now - start), fired, nrising);
+      ++stats->pulses;
+      stats->merged += nrising ? nrising - 1 : 0;
+      pulse_start = now;
+      pulsed = true;
+    }
+    else if (pulsed && nrising && now - pulse_start < limits.merge)
+      stats->merged += nrising;
+    if (!level && pulse_level) {  // a pulse ended
+      sim_time_t width = now - pulse_start;
+      if (width < stats->min_width) stats->min_width = width;
+      if (width > stats->max_width) stats->max_width = width;
+      if (width + TICK < limits.pulse || width > limits.pulse + TICK) violation(stats, now, start, "a pulse had the wrong length");
+      stats->on_time += width;
+    }
+    pulse_level = level;
+    sim_time_t next = sim_next_event();
+    if (!Playtune::tune_playing || next > stop_time) break;
+    sim_run_until(next);
+  }
+  pt.tune_stopscore();
+}
+
+int main(int argc, char **argv) {
+  int argn;
+  for (argn = 1; argn < argc && argv[argn][0] == '-'; ++argn) {
+    const char *arg = argv[argn] + 2;
+    switch (argv[argn][1]) {
+      case 'f': sim_f_cpu = (unsigned long)(atof(arg) * 1000000); break;
+      case 'c': max_chans = atoi(arg); break;
+      case 's': max_seconds = atof(arg); break;
+      case 'v': verbose = true; break;
+      default:
+        fprintf(stderr, "unknown option %s\n", argv[argn]);
+        return 1;
+    }
+  }
+  if (argn >= argc || sim_f_cpu == 0) {
+    fprintf(stderr, "usage: playtune_tesla [-fN] [-cN] [-sN] [-v] file ...\n");
+    return 1;
+  }
+  std::vector<playtune_score> scores;
+  for (; argn < argc; ++argn)
+    if (!sim_load_scores(argv[argn], scores)) return 1;
+
+  sim_tesla_limits(&limits);
+  for (int chan = 0, pin = 2; chan < max_chans && chan < MAX_CHANS; ++chan, ++pin) {
+    if (pin == limits.pin) ++pin;
+    pt.tune_initchan(pin);   // (extra calls are ignored)
+  }
+  printf("%s at %.1f Mhz, %d tone generators: pulses of %.1f usec on pin %d, merged within %.1f usec,\n"
+         "   each tone generator at most every %.1f usec, duty at most %.1f%% with bursts of %d\n",
+         sim_mcu_name(), sim_f_cpu / 1e6, sim_num_chans(), sim_seconds(limits.pulse) * 1e6, limits.pin,
+         sim_seconds(limits.merge) * 1e6, sim_seconds(limits.voice) * 1e6,
+         100.0 * limits.pulse / limits.spacing, limits.burst);
+
+  int failures = 0;
+  for (size_t i = 0; i < scores.size(); ++i) {
+    tesla_stats_t stats;
+    sim_time_t start = sim_now();
+    check_score(scores[i], &stats);
+    double seconds = sim_seconds(sim_now() - start);
+    printf("%s: %.1f seconds, %lu edges, %lu pulses of %.1f to %.1f usec, %lu merged, %lu dropped;\n"
+           "   duty %.2f%% average, %.2f%% peak over %.0f msec: %s\n",
+           score_basename(scores[i]).c_str(), seconds, stats.edges, stats.pulses,
+           stats.pulses ? sim_seconds(stats.min_width) * 1e6 : 0, sim_seconds(stats.max_width) * 1e6,
+           stats.merged, stats.edges - stats.pulses - stats.merged,
+           seconds > 0 ? 100 * sim_seconds(stats.on_time) / seconds : 0,
+           100 * sim_seconds(stats.peak_on_time) / DUTY_WINDOW, DUTY_WINDOW * 1000,
+           stats.errors ? "LIMITS BROKEN" : "ok");
+    if (stats.errors) ++failures;
+  }
+  return failures ? 1 : 0;
+}
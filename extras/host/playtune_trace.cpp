@@ -0,0 +1,359 @@
+/**************************************************************************
+*
+*  playtune_trace: event traces of the Playtune score interpreter
+*
+*  This plays scores through the real Playtune code on the simulated
+*  processor and records a compact trace of what the tone generators do:
+*
+*     time   when it happened, in microseconds from the start of the score
+*     type   n: a note was started, with this compare value and prescaler
+*            s: the note was stopped
+*            e: the first output edge after a note was started
+*            c: at the end, the number of output edges on the channel
+*     chan   the tone generator
+*     ocr    the timer's compare value (for "c", the number of edges)
+*     pre    the timer's prescaler
+*     level  the output pin after the event
+*
+*  Traces can be saved as golden files and later compared against, so that
+*  changes to tune_stepscore() or to the timer arithmetic that change what
+*  is heard don't go unnoticed. The simulation is exact, so by default any
+*  difference fails the comparison. With a tolerance, the times may differ
+*  by that much, and the edge counts by 0.1% plus one. The golden traces of
+*  the example scores for each processor are in the golden directory.
+*
+*  Usage: playtune_trace [-fN] [-cN] [-sN] [-tN] [-i] [-wDIR | -dDIR | -bN] file ...
+*     -fN   processor clock in Mhz (default 16)
+*     -cN   use only N tone generators (default: all the processor has)
+*     -sN   stop after N seconds if the score hasn't ended (default 600)
+*     -tN   timing tolerance for comparisons, in microseconds (default 0)
+*     -i    count the interrupts taken while playing each score, by vector,
+*           and with TUNE_ARPEGGIO, what the arpeggio turns on timer 1 cost
+*     -wDIR write the traces as golden files DIR/<score>.trace, making DIR
+*           if it doesn't exist
+*     -dDIR compare the traces with the golden files DIR/<score>.trace
+*     -bN   benchmark: play each score N times and report the speed
+*  Without -w, -d, -b, or -i, the traces are written to stdout.
+*
+*  With -d, it also checks that tune_delay() takes its whole time, both
+*  while the tone generators are set up and after tune_stopchans().
+*  The exit status is 1 if any trace differs from its golden file, or a
+*  delay is wrong.
+*
+*  Build it for the processor you want to simulate, for example:
+*     g++ -O2 -I. -D__AVR_ATmega328P__ -o playtune_trace
+*         playtune_trace.cpp playtune_sim.cpp playtune_score.cpp
+*
+*  (C) Copyright 2026, the Playtune contributors. MIT License, as in Playtune.cpp
+*
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "playtune_sim.h"
+#include "playtune_score.h"
+#include "playtune_model.h"   // (only for the cycle estimates)
+
+#define MAX_CHANS 16
+#define MAX_DIFFS 10   // differences to show for each score
+
+struct trace_event {
+  double time;           // usec
+  char type;             // n, s, e, or c
+  int chan;
+  unsigned long ocr;
+  unsigned long prescale;
+  int level;
+};
+
+static int max_chans = MAX_CHANS;
+static double max_seconds = 600;
+static double tolerance = 0;
+static int bench_passes = 0;
+static bool count_interrupts = false;
+static const char *write_dir = NULL, *diff_dir = NULL;
+
+static Playtune pt;
+
+struct chan_state_t {
+  bool sounding, edge_pending;
+  unsigned ocr;
+  unsigned long prescale, restarts, edges;
+  bool level;
+};
+
+static void trace_score(const playtune_score &score, std::vector<trace_event> &trace) {
+  // Play the score and record what the tone generators do.
+  chan_state_t chans[MAX_CHANS];
+  int nchans = sim_num_chans();
+  sim_time_t start = sim_now(), stop_time = start + (sim_time_t)(max_seconds * sim_f_cpu);
+  memset(chans, 0, sizeof(chans));
+  for (int chan = 0; chan < nchans; ++chan) {
+    chans[chan].level = sim_pin_level(sim_chan_pin(chan));
+    chans[chan].restarts = sim_timer_restarts(sim_chan_timer(chan));
+  }
+  pt.tune_playscore(&score.data[0]);
+  while (1) {
+    double usec = sim_seconds(sim_now() - start) * 1e6;
+    for (int chan = 0; chan < nchans; ++chan) {
+      chan_state_t *c = &chans[chan];
+      int timer = sim_chan_timer(chan);
+      bool sounding = sim_chan_sounding(chan);
+      unsigned ocr = sim_timer_ocr(timer);
+      unsigned long prescale = sim_timer_prescale(timer), restarts = sim_timer_restarts(timer);
+      bool level = sim_pin_level(sim_chan_pin(chan));
+      if (sounding != c->sounding
+          || (sounding && (ocr != c->ocr || prescale != c->prescale || restarts != c->restarts))) {
+        trace_event ev = { usec, sounding ? 'n' : 's', chan, ocr, prescale, level };
+        trace.push_back(ev);
+        c->edge_pending = sounding;
+        c->level = level;  // (stopping a note can force the pin low)
+      }
+      if (level != c->level) {
+        ++c->edges;
+        if (c->edge_pending) {
+          trace_event ev = { usec, 'e', chan, ocr, prescale, level };
+          trace.push_back(ev);
+          c->edge_pending = false;
+        }
+      }
+      c->sounding = sounding;
+      c->ocr = ocr;
+      c->prescale = prescale;
+      c->restarts = restarts;
+      c->level = level;
+    }
+    sim_time_t next = sim_next_event();
+    if (!Playtune::tune_playing || next > stop_time) break;
+    sim_run_until(next);
+  }
+  pt.tune_stopscore();
+  double usec = sim_seconds(sim_now() - start) * 1e6;
+  for (int chan = 0; chan < nchans; ++chan) {
+    trace_event ev = { usec, 'c', chan, chans[chan].edges, 0, 0 };
+    trace.push_back(ev);
+  }
+}
+
+static void show_interrupts(const playtune_score &score, double seconds,
+                            unsigned long long before[SIM_NUM_TIMERS][SIM_NUM_SOURCES]) {
+  static const char *const source_names[SIM_NUM_SOURCES] = { "compa", "compb", "ovf" };
+  unsigned long long total = 0;
+  for (int n = 0; n < SIM_NUM_TIMERS; ++n)
+    for (int s = 0; s < SIM_NUM_SOURCES; ++s) total += sim_vector_counts[n][s] - before[n][s];
+  printf("%s: %.1f seconds, %llu interrupts (%.0f/s):", score_basename(score).c_str(),
+         seconds, total, seconds > 0 ? total / seconds : 0);
+  for (int n = 0; n < SIM_NUM_TIMERS; ++n)
+    for (int s = 0; s < SIM_NUM_SOURCES; ++s)
+      if (sim_vector_counts[n][s] != before[n][s])
+        printf(" timer%d %s %llu", n, source_names[s], sim_vector_counts[n][s] - before[n][s]);
+  printf("\n");
+}
+
+#if TUNE_ARPEGGIO
+static void show_arpeggio(double seconds, unsigned long long turns, unsigned long long alarms) {
+  // What the notes taking turns on timer 1 cost: every turn, and the alarms that were only for one
+  double cycles = turns * (double) CYCLES_ARPEGGIO_TURN + alarms * (double) (CYCLES_ISR_ENTRY + CYCLES_WAIT_ALARM);
+  printf("   arpeggio at %d Hz: %llu turns, %llu extra interrupts (%.0f/s), about %.0f cycles/s (%.2f%% of the processor)\n",
+         TUNE_ARPEGGIO, turns, alarms, seconds > 0 ? alarms / seconds : 0,
+         seconds > 0 ? cycles / seconds : 0, seconds > 0 ? 100 * cycles / seconds / sim_f_cpu : 0);
+}
+#endif
+
+static bool make_dir(const std::string &dir) {
+  // make a directory, and the ones above it, if they don't exist
+  size_t slash = dir.find_last_of('/');
+  if (slash != std::string::npos && slash > 0 && !make_dir(dir.substr(0, slash))) return false;
+  return mkdir(dir.c_str(), 0777) == 0 || errno == EEXIST;
+}
+
+static void write_trace(FILE *f, const playtune_score &score, const std::vector<trace_event> &trace) {
+  fprintf(f, "# Playtune trace of %s for the %s at %lu Hz\n",
+          score_basename(score).c_str(), sim_mcu_name(), sim_f_cpu);
+  fprintf(f, "#       time type chan    ocr  pre level\n");
+  for (size_t i = 0; i < trace.size(); ++i) {
+    const trace_event &ev = trace[i];
+    fprintf(f, "%12.3f %c %2d %6lu %4lu %d\n", ev.time, ev.type, ev.chan, ev.ocr, ev.prescale, ev.level);
+  }
+}
+
+static bool read_trace(const char *filename, std::vector<trace_event> &trace) {
+  FILE *f = fopen(filename, "r");
+  if (!f) {
+    fprintf(stderr, "can't open %s\n", filename);
+    return false;
+  }
+  char line[200];
+  while (fgets(line, sizeof(line), f)) {
+    trace_event ev;
+    if (line[0] == '#') continue;
+    if (sscanf(line, "%lf %c %d %lu %lu %d", &ev.time, &ev.type, &ev.chan, &ev.ocr, &ev.prescale, &ev.level) == 6)
+      trace.push_back(ev);
+  }
+  fclose(f);
+  return true;
+}
+
+static double as_written(double time) {
+  // the time as it is written in a trace file, to a thousandth of a microsecond
+  char text[40];
+  snprintf(text, sizeof(text), "%.3f", time);
+  return atof(text);
+}
+
+static bool events_match(const trace_event &a, const trace_event &b) {
+  if (a.type != b.type || a.chan != b.chan || fabs(as_written(a.time) - as_written(b.time)) > tolerance) return false;
+  if (a.type == 'c') {
+    if (tolerance == 0) return a.ocr == b.ocr;
+    unsigned long diff = a.ocr > b.ocr ? a.ocr - b.ocr : b.ocr - a.ocr;
+    return diff <= a.ocr / 1000 + 1;
+  }
+  return a.ocr == b.ocr && a.prescale == b.prescale && a.level == b.level;
+}
+
+static void show_event(const char *which, const trace_event &ev) {
+  printf("   %s %12.3f %c %2d %6lu %4lu %d\n", which, ev.time, ev.type, ev.chan, ev.ocr, ev.prescale, ev.level);
+}
+
+static bool compare_trace(const char *filename, const std::vector<trace_event> &trace) {
+  std::vector<trace_event> golden;
+  if (!read_trace(filename, golden)) return false;
+  int diffs = 0;
+  size_t n = golden.size() < trace.size() ? golden.size() : trace.size();
+  for (size_t i = 0; i < n; ++i)
+    if (!events_match(golden[i], trace[i])) {
+      if (++diffs <= MAX_DIFFS) {
+        printf("  event %u differs:\n", (unsigned) i);
+        show_event("golden:", golden[i]);
+        show_event("now:   ", trace[i]);
+      }
+    }
+  if (golden.size() != trace.size()) {
+    printf("  %u events instead of %u\n", (unsigned) trace.size(), (unsigned) golden.size());
+    ++diffs;
+  }
+  if (diffs) printf("%s: %d differences\n", filename, diffs);
+  else printf("%s: ok, %u events\n", filename, (unsigned) trace.size());
+  return diffs == 0;
+}
+
+#if TUNE_DELAY
+static bool check_delay(const char *when, unsigned msec) {
+  // tune_delay() must take the whole time, less at most the alarm's margin
+  sim_time_t start = sim_now();
+  pt.tune_delay(msec);
+  double took = sim_seconds(sim_now() - start) * 1000;
+  bool ok = took <= msec && took >= msec - 0.1;
+  printf("tune_delay(%u) %s: %.3f msec: %s\n", msec, when, took, ok ? "ok" : "WRONG");
+  return ok;
+}
+#endif
+
+static void benchmark(const playtune_score &score) {
+  playtune_decoded decoded;
+  decode_score(score, decoded);
+  unsigned long long interrupts = sim_interrupts;
+  sim_time_t start = sim_now(), stop_time = (sim_time_t)(max_seconds * sim_f_cpu);
+  clock_t cpu_start = clock();
+  for (int pass = 0; pass < bench_passes; ++pass) {
+    sim_time_t pass_start = sim_now();
+    pt.tune_playscore(&score.data[0]);
+    sim_time_t next;
+    while (Playtune::tune_playing && (next = sim_next_event()) - pass_start <= stop_time)
+      sim_run_until(next);
+    pt.tune_stopscore();
+  }
+  double cpu = (double)(clock() - cpu_start) / CLOCKS_PER_SEC;
+  double music = sim_seconds(sim_now() - start);
+  double events = (double) decoded.cmds.size() * bench_passes;
+  if (cpu <= 0) cpu = 1e-6;
+  printf("%s: %d x %.1f seconds in %.2f seconds (%.0fx real time), %.0f events/s, %.0f interrupts/s\n",
+         score_basename(score).c_str(), bench_passes, music / bench_passes, cpu, music / cpu,
+         events / cpu, (sim_interrupts - interrupts) / cpu);
+}
+
+int main(int argc, char **argv) {
+  int argn;
+  for (argn = 1; argn < argc && argv[argn][0] == '-'; ++argn) {
+    const char *arg = argv[argn] + 2;
+    switch (argv[argn][1]) {
+      case 'f': sim_f_cpu = (unsigned long)(atof(arg) * 1000000); break;
+      case 'c': max_chans = atoi(arg); break;
+      case 's': max_seconds = atof(arg); break;
+      case 't': tolerance = atof(arg); break;
+      case 'w': write_dir = arg; break;
+      case 'd': diff_dir = arg; break;
+      case 'b': bench_passes = atoi(arg); break;
+      case 'i': count_interrupts = true; break;
+      default:
+        fprintf(stderr, "unknown option %s\n", argv[argn]);
+        return 1;
+    }
+  }
+  if (argn >= argc || sim_f_cpu == 0) {
+    fprintf(stderr, "usage: playtune_trace [-fN] [-cN] [-sN] [-tN] [-i] [-wDIR | -dDIR | -bN] file ...\n");
+    return 1;
+  }
+  std::vector<playtune_score> scores;
+  for (; argn < argc; ++argn)
+    if (!sim_load_scores(argv[argn], scores)) return 1;
+
+  if (write_dir && !make_dir(write_dir)) {
+    fprintf(stderr, "can't create directory %s\n", write_dir);
+    return 1;
+  }
+  for (int chan = 0; chan < max_chans && chan < MAX_CHANS; ++chan)
+    pt.tune_initchan(2 + chan);   // (extra calls are ignored)
+
+  int failures = 0;
+  for (size_t i = 0; i < scores.size(); ++i) {
+    if (bench_passes > 0) {
+      benchmark(scores[i]);
+      continue;
+    }
+    std::vector<trace_event> trace;
+    unsigned long long before[SIM_NUM_TIMERS][SIM_NUM_SOURCES];
+    memcpy(before, sim_vector_counts, sizeof(before));
+#if TUNE_ARPEGGIO
+    unsigned long long turns = sim_arpeggio_turns, alarms = sim_arpeggio_alarms;
+#endif
+    sim_time_t start = sim_now();
+    trace_score(scores[i], trace);
+    if (count_interrupts) {
+      show_interrupts(scores[i], sim_seconds(sim_now() - start), before);
+#if TUNE_ARPEGGIO
+      show_arpeggio(sim_seconds(sim_now() - start), sim_arpeggio_turns - turns, sim_arpeggio_alarms - alarms);
+#endif
+    }
+    std::string golden = score_basename(scores[i]) + ".trace";
+    if (write_dir) {
+      golden = std::string(write_dir) + "/" + golden;
+      FILE *f = fopen(golden.c_str(), "w");
+      if (!f) {
+        fprintf(stderr, "can't create %s\n", golden.c_str());
+        return 1;
+      }
+      write_trace(f, scores[i], trace);
+      fclose(f);
+      printf("%s: %u events\n", golden.c_str(), (unsigned) trace.size());
+    }
+    else if (diff_dir) {
+      golden = std::string(diff_dir) + "/" + golden;
+      if (!compare_trace(golden.c_str(), trace)) ++failures;
+    }
+    else if (!count_interrupts) write_trace(stdout, scores[i], trace);
+  }
+#if TUNE_DELAY
+  if (diff_dir) {  // timer 1 keeps counting after tune_stopchans(), so delays still work
+    if (!check_delay("with the tone generators", 100)) ++failures;
+    pt.tune_stopchans();
+    if (!check_delay("after tune_stopchans()", 100)) ++failures;
+  }
+#endif
+  return failures ? 1 : 0;
+}
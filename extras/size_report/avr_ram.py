@@ -0,0 +1,80 @@
+# Playtune RAM count: the bytes of RAM the variables defined in a source file take
+# on an AVR processor, worked out from the debugging information of the file compiled
+# for the host. On the AVR an int and a pointer take 2 bytes, a long 4, and nothing
+# is padded. Variables whose declaration line says PROGMEM are in flash, and are left
+# out. See ram_report.sh, which uses it.
+#
+#    python3 avr_ram.py object.o source.cpp [-v]
+#
+# With -v it also lists the variables, largest first.
+import sys, re, subprocess
+obj, source = sys.argv[1], sys.argv[2]
+src = open(source).read().split('\n')
+dump = subprocess.run(['readelf', '--debug-dump=info', obj], capture_output=True, text=True).stdout
+dies, order, stack = {}, [], []
+cur = None
+for line in dump.split('\n'):
+    m = re.match(r'\s*<(\d+)><([0-9a-f]+)>: Abbrev Number: (\d+)(?: \((\w+)\))?', line)
+    if m:
+        level, off = int(m.group(1)), int(m.group(2), 16)
+        if m.group(4) is None:
+            del stack[level:]; cur = None; continue
+        cur = {'tag': m.group(4), 'off': off, 'level': level, 'children': []}
+        del stack[level:]
+        if stack: stack[-1]['children'].append(cur)
+        stack.append(cur)
+        dies[off] = cur; order.append(cur)
+        continue
+    m = re.match(r'\s*<[0-9a-f]+>\s+(DW_AT_\w+)\s*:\s*(.*)', line)
+    if m and cur is not None:
+        cur[m.group(1)] = m.group(2).strip()
+def ref(d, a):
+    m = re.search(r'<0x([0-9a-f]+)>', d.get(a, ''))
+    return dies[int(m.group(1), 16)] if m else None
+def name(d):
+    v = d.get('DW_AT_name', '')
+    return v.split(': ')[-1] if v else ''
+FIXED = {'uint8_t': 1, 'int8_t': 1, 'uint16_t': 2, 'int16_t': 2, 'uint32_t': 4, 'int32_t': 4,
+         'uint64_t': 8, 'int64_t': 8, 'byte': 1, 'boolean': 1}
+def size(t):
+    if t is None: return 0
+    tag = t['tag']
+    if tag == 'DW_TAG_typedef':
+        return FIXED.get(name(t)) or size(ref(t, 'DW_AT_type'))
+    if tag in ('DW_TAG_const_type', 'DW_TAG_volatile_type'): return size(ref(t, 'DW_AT_type'))
+    if tag in ('DW_TAG_pointer_type', 'DW_TAG_reference_type'): return 2
+    if tag == 'DW_TAG_enumeration_type': return 2
+    if tag == 'DW_TAG_base_type':
+        n = name(t)
+        if 'char' in n or n == 'bool': return 1
+        if 'long long' in n: return 8
+        if 'long' in n: return 4
+        if 'short' in n or 'int' in n: return 2
+        if n == 'float' or n == 'double': return 4
+        raise Exception('base type ' + n)
+    if tag in ('DW_TAG_structure_type', 'DW_TAG_class_type'):
+        return sum(size(ref(c, 'DW_AT_type')) for c in t['children']
+                   if c['tag'] == 'DW_TAG_member' and 'DW_AT_external' not in c and 'DW_AT_declaration' not in c)
+    if tag == 'DW_TAG_union_type':
+        return max(size(ref(c, 'DW_AT_type')) for c in t['children'] if c['tag'] == 'DW_TAG_member')
+    if tag == 'DW_TAG_array_type':
+        n = 1
+        for c in t['children']:
+            if c['tag'] == 'DW_TAG_subrange_type':
+                ub = c.get('DW_AT_upper_bound') or c.get('DW_AT_count')
+                n *= int(ub.split()[0], 0) + (1 if 'DW_AT_upper_bound' in c else 0)
+        return n * size(ref(t, 'DW_AT_type'))
+    raise Exception('type ' + tag)
+total, rows = 0, []
+for d in order:
+    if d['tag'] != 'DW_TAG_variable' or 'DW_OP_addr' not in d.get('DW_AT_location', ''): continue
+    spec = ref(d, 'DW_AT_specification')
+    decl = spec or d
+    line = int(decl.get('DW_AT_decl_line', '0').split()[0], 0)
+    if 'PROGMEM' in (src[line - 1] if line else ''): continue
+    t = ref(d, 'DW_AT_type') or ref(decl, 'DW_AT_type')
+    s = size(t); total += s
+    rows.append((s, name(decl)))
+if '-v' in sys.argv:
+    for s, n in sorted(rows, reverse=True): print('%5d %s' % (s, n))
+print(total)
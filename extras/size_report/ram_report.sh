@@ -0,0 +1,46 @@
+#!/bin/sh
+#
+# Playtune RAM report: the RAM Playtune's own variables take in each build configuration
+#
+# This is for when arduino-cli isn't at hand: it needs only g++, readelf, and python3.
+# It compiles Playtune.cpp for the host with the stand-in Arduino headers of
+# extras/host, once for each of the configurations in size_report.sh, and counts the
+# bytes its variables would take on the AVR from their types (see avr_ram.py). That
+# leaves out the Arduino core, the sketch, and the stack, and it says nothing about
+# flash, which only size_report.sh can measure. The last column shows how much each
+# line saves over the one above.
+#
+#    sh ram_report.sh [processor]
+#
+# The processor is as in the avr-gcc macro __AVR_<processor>__; the default is
+# ATmega328P. The fixed pins are those of size_report.sh, for a Nano or Uno.
+
+mcu=${1:-ATmega328P}
+here=$(cd "$(dirname "$0")" && pwd)
+library=$(cd "$here/../.." && pwd)
+build=$(mktemp -d)
+trap 'rm -rf "$build"' EXIT
+
+pins="-DTUNE_PORT0=B -DTUNE_BIT0=2 -DTUNE_PORT1=B -DTUNE_BIT1=3 -DTUNE_PORT2=B -DTUNE_BIT2=4"
+
+report() {  # report "name" "compiler options"
+  if ! g++ -g -O0 -c -I"$library/extras/host" -D__AVR_${mcu}__ $2 -o "$build/playtune.o" \
+       "$library/Playtune.cpp"; then
+    echo "$1: the compile failed"
+    exit 1
+  fi
+  ram=$(python3 "$here/avr_ram.py" "$build/playtune.o" "$library/Playtune.cpp") || exit 1
+  printf "%-34s %6d %6d\n" "$1" "$ram" $((${last_ram:-$ram} - ram))
+  last_ram=$ram
+}
+
+echo "Playtune's variables on the $mcu"
+printf "%-34s %6s %6s\n" "configuration" "RAM" "saves"
+report "with TUNE_LINK 1" "-DTUNE_LINK=1"
+report "the defaults" ""
+report "  and TUNE_DELAY 0" "-DTUNE_DELAY=0"
+report "  and TUNE_HEADER 0" "-DTUNE_DELAY=0 -DTUNE_HEADER=0"
+report "  and TUNE_QUEUE_SIZE 1" "-DTUNE_DELAY=0 -DTUNE_HEADER=0 -DTUNE_QUEUE_SIZE=1"
+report "  and TUNE_VERIFY 0" "-DTUNE_DELAY=0 -DTUNE_HEADER=0 -DTUNE_QUEUE_SIZE=1 -DTUNE_VERIFY=0"
+report "  and fixed pins" "-DTUNE_DELAY=0 -DTUNE_HEADER=0 -DTUNE_QUEUE_SIZE=1 -DTUNE_VERIFY=0 $pins"
+report "  and TUNE_CHANS 1" "-DTUNE_DELAY=0 -DTUNE_HEADER=0 -DTUNE_QUEUE_SIZE=1 -DTUNE_VERIFY=0 $pins -DTUNE_CHANS=1"
@@ -0,0 +1,20 @@
+// A small sketch for measuring how much flash and RAM Playtune takes in each of
+// its build configurations. See size_report.sh, which compiles it.
+
+#include <Playtune.h>
+
+const byte PROGMEM score [] = {
+  0x90,0x48, 0x91,0x4C, 0x92,0x4F, 1,244, 0x80, 0x81, 0x82, 0xf0};
+
+Playtune pt;
+
+void setup() {
+  pt.tune_initchan (10);  // port B, bits 2, 3, and 4 on a Nano or Uno
+  pt.tune_initchan (11);
+  pt.tune_initchan (12);
+}
+
+void loop() {
+  pt.tune_playscore (score); /* start playing */
+  while (pt.tune_playing) pt.tune_idle(); /* sleep here until playing stops */
+}
@@ -0,0 +1,55 @@
+#!/bin/sh
+#
+# Playtune size report: the flash and RAM each build configuration takes
+#
+# This compiles the small sketch in this directory with arduino-cli, once for each
+# of the configurations below, and shows the program memory (flash) and the data
+# memory for variables (RAM) it uses. The first line adds the link, which is off by
+# default; each configuration after the defaults adds to the one above it. The
+# last two columns show how much each line saves over the one above. It needs
+# arduino-cli and the Arduino AVR core ("arduino-cli core install arduino:avr").
+#
+# The script hasn't been run for this release, so the READMEs quote no flash sizes.
+# ram_report.sh counts the RAM of Playtune's own variables without arduino-cli.
+#
+#    sh size_report.sh [board]
+#
+# The board is an arduino-cli board name; the default is arduino:avr:nano. The
+# fixed pins are the sketch's pins 10, 11, and 12 on a Nano or Uno, so change
+# them for other boards.
+
+board=${1:-arduino:avr:nano}
+here=$(cd "$(dirname "$0")" && pwd)
+library=$(cd "$here/../.." && pwd)
+build=$(mktemp -d)
+trap 'rm -rf "$build"' EXIT
+
+pins="-DTUNE_PORT0=B -DTUNE_BIT0=2 -DTUNE_PORT1=B -DTUNE_BIT1=3 -DTUNE_PORT2=B -DTUNE_BIT2=4"
+n=0
+
+report() {  # report "name" "compiler options"
+  n=$((n + 1))
+  out=$(arduino-cli compile --fqbn "$board" --library "$library" --build-path "$build/$n" \
+        --build-property "compiler.cpp.extra_flags=$2" "$here" 2>&1)
+  if [ $? -ne 0 ]; then
+    echo "$1: the compile failed"
+    echo "$out"
+    exit 1
+  fi
+  flash=$(echo "$out" | sed -n 's/^Sketch uses \([0-9]*\) bytes.*/\1/p')
+  ram=$(echo "$out" | sed -n 's/^Global variables use \([0-9]*\) bytes.*/\1/p')
+  printf "%-34s %6d %6d %6d %6d\n" "$1" "$flash" "$ram" $((${last_flash:-$flash} - flash)) $((${last_ram:-$ram} - ram))
+  last_flash=$flash
+  last_ram=$ram
+}
+
+echo "Playtune on $board"
+printf "%-34s %6s %6s %6s %6s\n" "configuration" "flash" "RAM" "saves" "saves"
+report "with TUNE_LINK 1" "-DTUNE_LINK=1"
+report "the defaults" ""
+report "  and TUNE_DELAY 0" "-DTUNE_DELAY=0"
+report "  and TUNE_HEADER 0" "-DTUNE_DELAY=0 -DTUNE_HEADER=0"
+report "  and TUNE_QUEUE_SIZE 1" "-DTUNE_DELAY=0 -DTUNE_HEADER=0 -DTUNE_QUEUE_SIZE=1"
+report "  and TUNE_VERIFY 0" "-DTUNE_DELAY=0 -DTUNE_HEADER=0 -DTUNE_QUEUE_SIZE=1 -DTUNE_VERIFY=0"
+report "  and fixed pins" "-DTUNE_DELAY=0 -DTUNE_HEADER=0 -DTUNE_QUEUE_SIZE=1 -DTUNE_VERIFY=0 $pins"
+report "  and TUNE_CHANS 1" "-DTUNE_DELAY=0 -DTUNE_HEADER=0 -DTUNE_QUEUE_SIZE=1 -DTUNE_VERIFY=0 $pins -DTUNE_CHANS=1"